@@ -3033,6 +3033,10 @@ void exec_assignment(void) {
 #endif
   if (assignop=='=') {
     basicvars.current++;
+    if (destination.typeinfo==VAR_FLOATARRAY && *destination.address.arrayaddr!=NIL && eval_fusedarray(*destination.address.arrayaddr)) {
+      DEBUGFUNCMSGOUT;
+      return;
+    }
     expression();
     (*assign_table[destination.typeinfo])(destination.address);
   }
@@ -4046,6 +4050,10 @@ void exec_let(void) {
   get_lvalue(&destination);           /* Get left hand side of assignment */
   if (*basicvars.current=='=') {
     basicvars.current++;
+    if (destination.typeinfo==VAR_FLOATARRAY && *destination.address.arrayaddr!=NIL && eval_fusedarray(*destination.address.arrayaddr)) {
+      DEBUGFUNCMSGOUT;
+      return;
+    }
     expression();
     (*assign_table[destination.typeinfo])(destination.address);
   } else {                            /* No '=' found */
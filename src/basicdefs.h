@@ -528,6 +528,7 @@ typedef struct {
     unsigned int ignore_starcmd:1;/* TRUE if built-in '*' commands are ignored */
     unsigned int startfullscreen:1; /* TRUE if we start in fullscreen in SDL mode */
     unsigned int swsurface:1; /* TRUE if we want a software surface */
+    unsigned int headless:1;  /* TRUE if the SDL build is to draw without opening a window */
   } runflags;                 /* Various runtime flags */
   struct {
     unsigned int enabled:1;   /* TRUE if any trace options are enabled */
@@ -617,6 +618,7 @@ typedef struct {
   uint32 osbyte4val;          /* OSBYTE 4 value, default = 0 */
   int32 printer_ignore;       /* Printer ignore character, default = 10 */
   uint8 translatefname;       /* Translate filename? */
+  int32 maxfiles;             /* Limit on number of open files (0 = default) */
   boolean hex64;              /* Decode hex in 64-bit? */
   boolean bitshift64;         /* Do bit shifts work in 64-bit space? */
   boolean pseudovarsunsigned; /* Unsigned pseudovars on 32-bit */
@@ -296,6 +296,7 @@ static void init1(void) {
   matrixflags.printer = NULL;         /* By default, printer is closed */
   matrixflags.printer_ignore = 13;    /* By default, ignore carriage return characters */
   matrixflags.translatefname = 2;     /* 0 = Don't, 1 = Always, 2 = Attempt autodetect */
+  matrixflags.maxfiles = 0;           /* Use the default limit on open files */
   matrixflags.startupmode = BRANDY_STARTUP_MODE;  /* Defaults to 0 */
 #ifndef BRANDY_NOVERCHECK
 #ifdef BRANDYAPP
@@ -430,6 +431,8 @@ static void check_configfile() {
       matrixflags.neverfullscreen=TRUE;
     } else if(!strncmp(item, "swsurface", 10)) {
       basicvars.runflags.swsurface=TRUE;
+    } else if(!strncmp(item, "headless", 9)) {
+      basicvars.runflags.headless=TRUE;
     } else if(!strncmp(item, "zoom", 5)) {
       if(parameter) {
         char *sp;
@@ -445,6 +448,8 @@ static void check_configfile() {
       basicvars.runflags.flag_cosmetic = TRUE;
     } else if(!strncmp(item, "nostar", 7)) {
       basicvars.runflags.ignore_starcmd = TRUE;
+    } else if(!strncmp(item, "maxfiles", 9)) {
+      if(parameter) matrixflags.maxfiles = CAST(strtol(parameter, NIL, 10), int32);
     } else if(!strncmp(item, "size", 5)) {
       if(parameter) {
         char *sp;
@@ -525,6 +530,12 @@ static void check_cmdline(int argc, char *argv[]) {
     p = argv[n];
     if (*p=='-' && !had_double_dash) {  /* Got an option */
       optchar = tolower(*(p+1));        /* Get first character of option name */
+#ifdef USE_SDL
+      if (optchar=='h' && tolower(*(p+2))=='e' && tolower(*(p+3))=='a') {     /* -headless */
+        basicvars.runflags.headless=TRUE;
+      }
+      else
+#endif
       if (optchar=='h') {               /* -help */
         show_help();
         exit(0);
@@ -640,6 +651,13 @@ static void check_cmdline(int argc, char *argv[]) {
           }
         }
       }
+      else if (optchar=='m' && tolower(*(p+2))=='a' && tolower(*(p+3))=='x') {  /* -maxfiles */
+        n++;
+        if (n==argc)
+          cmderror(CMD_NOVALUE, p);         /* File limit missing */
+        else
+          matrixflags.maxfiles = CAST(strtol(argv[n], NIL, 10), int32);
+      }
       else if (optchar=='!')                /* -! - Don't initialise signal handlers */
         basicvars.misc_flags.trapexcp = FALSE;
       else if (optchar=='-' && *(p+2) == 0) /* -- - Pass all remaining options to the Basic program */
@@ -41,6 +41,7 @@
 #include "miscprocs.h"
 #include "keyboard.h"
 #include "net.h"
+#include "mos.h"
 #ifdef USE_SDL
 #include "graphsdl.h"
 #endif
@@ -375,6 +376,7 @@ void show_help(void) {
   printf("  -fullscreen    Start Brandy in fullscreen mode\n");
   printf("  -nofull        Never use fullscreen mode\n");
   printf("  -swsurface     Use a software SDL surface\n");
+  printf("  -headless      Draw graphics without opening a window\n");
   printf("  -zoom <amount> Zoom display by <amount>:1\n");
 #endif
 #if !defined(TARGET_RISCOS) && !defined(TARGET_MINGW) && !defined(USE_SDL)
@@ -396,6 +398,7 @@ void show_help(void) {
 #ifndef TARGET_RISCOS
   printf("  -nostar        Do not check OSCLI for internal *-commands, instead pass all\n");
   printf("                 commands to the underlying operating system.\n");
+  printf("  -maxfiles <n>  Allow up to <n> files to be open at once (default 4096)\n");
 #endif
   printf("  --             Subsequent options are passed to Basic program\n");
   printf("  <file>         Run Basic program <file> and leave interpreter when it ends\n\n");
@@ -412,7 +415,8 @@ static detail badcmdtable [] = {
   {WARNING, STRING, 0, "Basic workspace size is missing after option '%s'\n"},
   {WARNING, NOPARM, 0, "The name of the file to load has already been supplied\n"},
   {WARNING, NOPARM, 0, "There is not enough memory available to run the interpreter\n"},
-  {WARNING, NOPARM, 0, "Initialisation of the interpreter failed\n"}
+  {WARNING, NOPARM, 0, "Initialisation of the interpreter failed\n"},
+  {WARNING, STRING, 0, "No value was supplied after option '%s'\n"}
 };
 
 /*
@@ -623,6 +627,7 @@ static detail errortable [] = {
 /* ERR_NET_CONNREFUSED*/{NONFATAL, NOPARM,  165, "Connection refused"},                  // 'No reply'
 /* ERR_NET_MAXSOCKETS */{NONFATAL, NOPARM,  192, "The maximum allowed number of sockets is already open"},
 /* ERR_NET_NOTFOUND */  {NONFATAL, NOPARM,  213, "Host not found"},                      // 'Disk not present'
+/* ERR_NET_INUSE */     {NONFATAL, NOPARM,  194, "Unable to listen on that port"},       // 'Already open'
 /* ERR_NO_RPI_GPIO */   {NONFATAL, NOPARM,  510, "Raspberry Pi GPIO not available"},
 //
 // Dynamic Linker errors
@@ -633,6 +638,8 @@ static detail errortable [] = {
 /* ERR_NODIR */         {NONFATAL, NOPARM,  189, "Unable to create directory"},
 /* ERR_FILELOCKED */    {NONFATAL, NOPARM,  195, "This item is locked to stop changes being made to it"},
 /* ERR_BAD_OSFILE */    {NONFATAL, NOPARM, 1026, "Bad OSFile call"},
+/* ERR_NOSPRITE */      {NONFATAL, NOPARM,  134, "Sprite doesn't exist"},
+/* ERR_SPRITEFULL */    {NONFATAL, NOPARM,  130, "No room for sprite"},
 //
 // DO NOT PUT ANYTHING BELOW THIS LINE - THIS MUST BE THE LAST ERROR
 /* HIGHERROR */         {FATAL,    NOPARM,    0, "You should never see this"} /* ALWAYS leave this as the last error */
@@ -773,6 +780,9 @@ static void print_details(boolean iserror) {
 */
 static void handle_error(errortype severity) {
   DEBUGFUNCMSGIN;
+#ifdef OSCLI_PIPE
+  mos_oscli_abandonpipe();      /* Error occurred while reading the output of 'OSCLI ... TO' */
+#endif
 #ifdef DEBUG
   if (basicvars.debug_flags.debug) {
     fprintf(stderr, "Error in Basic program - %s at line %d\n", errortext, basicvars.error_line);
@@ -195,6 +195,7 @@ typedef enum {
     ERR_NET_CONNREFUSED,/* 165, Connection refused */
     ERR_NET_MAXSOCKETS, /* 192, Maximum number of sockets already open */
     ERR_NET_NOTFOUND,   /* 213, Host not found */
+    ERR_NET_INUSE,      /* 194, Address already in use */
     ERR_NO_RPI_GPIO,    /* 510, Raspberry Pi GPIO not available */
 // Dynamic Linker errors
     ERR_DL_NODL,        /* 0, dlopen() and friends not available */
@@ -204,6 +205,8 @@ typedef enum {
     ERR_NODIR,          /* 104885 (189), Unable to create directory */
     ERR_FILELOCKED,     /* 67779  (195), This item is locked */
     ERR_BAD_OSFILE,     /* 1026, Bad OSFile call */
+    ERR_NOSPRITE,       /* 134, Sprite doesn't exist */
+    ERR_SPRITEFULL,     /* 130, No room for sprite */
 // No more errors
     HIGHERROR           /* Leave last, dummy error */
 } errnum;
@@ -215,6 +218,7 @@ typedef enum {
 #define CMD_FILESUPP  3 /* File name already supplied */
 #define CMD_NOMEMORY  4 /* Not enough memory to run the interpreter */
 #define CMD_INITFAIL  5 /* Interpreter initialisation failed */
+#define CMD_NOVALUE   6 /* No value supplied after option */
 
 extern void init_errors(void);
 extern void watch_signals(void);
@@ -956,64 +956,88 @@ static void do_arrayvar(void) {
 
 
 /*
-** 'do_arrayref' handles array references where an individual element is
-** being accessed. It deals with both simple references to them and
-** references followed by an indirection operator
+** 'patch_arrayref' is called after the indexes of a reference to an
+** element of a two or three dimensional array have been evaluated. If
+** every index is a simple 32-bit integer variable the array reference
+** token at 'tp' is replaced with BASTOKEN_ARRAYREF2 or BASTOKEN_ARRAYREF3
+** so that future references can pick up the index values directly
 */
-static void do_arrayref(void) {
-  variable *vp = GET_ADDRESS(basicvars.current, variable *);
-  int32 vartype, element = 0;
-  basicarray *descriptor;
+void patch_arrayref(byte *tp, int32 dimcount) {
+  byte *p = tp+LOFFSIZE+1;
+  int32 n;
 
   DEBUGFUNCMSGIN;
-  basicvars.current+=LOFFSIZE+1;        /* Skip pointer to variable */
-  descriptor = vp->varentry.vararray;
-  vartype = vp->varflags;
-  if (descriptor->dimcount == 1) {      /* Array has only one dimension - Use faster code */
-    expression();             /* Evaluate an array index */
-    element = pop_anynum32();
-    if (element < 0 || element >= descriptor->dimsize[0]) {
+  for (n = 0; n < dimcount; n++) {
+    if (*p == BASTOKEN_STATICVAR)
+      p+=2;
+    else if (*p == BASTOKEN_INTVAR)
+      p+=LOFFSIZE+1;
+    else {
       DEBUGFUNCMSGOUT;
-      error(ERR_BADINDEX, element, vp->varname);
       return;
     }
-  }
-  else {        /* Multi-dimensional array */
-    int32 dimcount = 0;
-    int32 maxdims = descriptor->dimcount;
-    element = 0;
-    do {        /* Gather the array indexes */
-      int32 index;
-      expression();           /* Evaluate an array index */
-      index = pop_anynum32();
-      if (index < 0 || index >= descriptor->dimsize[dimcount]) {
-        DEBUGFUNCMSGOUT;
-        error(ERR_BADINDEX, index, vp->varname);
-        return;
-      }
-      dimcount++;
-      element+=index;
-      if (*basicvars.current != ',') break;     /* No more array indexes expected */
-      basicvars.current++;
-      if (dimcount > maxdims) {  /* Too many dimensions */
-        DEBUGFUNCMSGOUT;
-        error(ERR_INDEXCO, vp->varname);
-        return;
-      }
-      if (dimcount != maxdims) element = element*descriptor->dimsize[dimcount];
-    } while (TRUE);
-    if (dimcount != maxdims) {   /* Not enough dimensions */
+    if (*p != (n == dimcount-1 ? ')' : ',')) {
       DEBUGFUNCMSGOUT;
-      error(ERR_INDEXCO, vp->varname);
       return;
     }
+    p++;
   }
-  if (*basicvars.current != ')') {
+  *tp = dimcount == 2 ? BASTOKEN_ARRAYREF2 : BASTOKEN_ARRAYREF3;
+  DEBUGFUNCMSGOUT;
+}
+
+/*
+** 'fast_element' returns the index of the array element referenced by a
+** BASTOKEN_ARRAYREF2 or BASTOKEN_ARRAYREF3 token, where every index is a
+** simple integer variable. basicvars.current is left pointing at
+** the character after the ')'. If the array no longer has the number of
+** dimensions that the token was created for, for example, a local array
+** that has been redefined, the token is turned back into an ordinary
+** array reference, basicvars.current is not changed and -1 is returned
+*/
+int32 fast_element(variable *vp) {
+  basicarray *descriptor = vp->varentry.vararray;
+  int32 dimcount = *basicvars.current == BASTOKEN_ARRAYREF2 ? 2 : 3;
+  int32 n, index, element = 0;
+  byte *p;
+
+  DEBUGFUNCMSGIN;
+  if (descriptor == NIL || descriptor->dimcount != dimcount) {
+    *basicvars.current = BASTOKEN_ARRAYREF;
     DEBUGFUNCMSGOUT;
-    error(ERR_RPMISS);
-    return;
+    return -1;
   }
-  basicvars.current++;          /* Point at character after the ')' */
+  p = basicvars.current+LOFFSIZE+1;
+  for (n = 0; n < dimcount; n++) {
+    if (*p == BASTOKEN_STATICVAR) {
+      index = basicvars.staticvars[*(p+1)].varentry.varinteger;
+      p+=3;
+    } else {
+      index = *GET_ADDRESS(p, int32 *);
+      p+=LOFFSIZE+2;
+    }
+    if (index < 0 || index >= descriptor->dimsize[n]) {
+      DEBUGFUNCMSGOUT;
+      error(ERR_BADINDEX, index, vp->varname);
+      return -1;
+    }
+    element = element*descriptor->dimsize[n]+index;
+  }
+  basicvars.current = p;        /* Point at character after the ')' */
+  DEBUGFUNCMSGOUT;
+  return element;
+}
+
+/*
+** 'push_element' pushes the value of element 'element' of array 'vp'
+** on to the Basic stack. The array reference can be followed by an
+** indirection operator, in which case the value of the array element
+** is used as the left-hand operand
+*/
+static void push_element(variable *vp, int32 element) {
+  int32 vartype = vp->varflags;
+
+  DEBUGFUNCMSGIN;
   if (*basicvars.current != '?' && *basicvars.current != '!') { /* Ordinary array reference */
     if (vartype == VAR_INTARRAY) {      /* Can push the array element on to the stack then go home */
       push_int(vp->varentry.vararray->arraystart.intbase[element]);
@@ -1071,6 +1095,88 @@ static void do_arrayref(void) {
   DEBUGFUNCMSGOUT;
 }
 
+/*
+** 'do_arrayref' handles array references where an individual element is
+** being accessed. It deals with both simple references to them and
+** references followed by an indirection operator
+*/
+static void do_arrayref(void) {
+  variable *vp = GET_ADDRESS(basicvars.current, variable *);
+  byte *tp = basicvars.current;
+  int32 element = 0;
+  basicarray *descriptor;
+
+  DEBUGFUNCMSGIN;
+  basicvars.current+=LOFFSIZE+1;        /* Skip pointer to variable */
+  descriptor = vp->varentry.vararray;
+  if (descriptor->dimcount == 1) {      /* Array has only one dimension - Use faster code */
+    expression();             /* Evaluate an array index */
+    element = pop_anynum32();
+    if (element < 0 || element >= descriptor->dimsize[0]) {
+      DEBUGFUNCMSGOUT;
+      error(ERR_BADINDEX, element, vp->varname);
+      return;
+    }
+  }
+  else {        /* Multi-dimensional array */
+    int32 dimcount = 0;
+    int32 maxdims = descriptor->dimcount;
+    element = 0;
+    do {        /* Gather the array indexes */
+      int32 index;
+      expression();           /* Evaluate an array index */
+      index = pop_anynum32();
+      if (index < 0 || index >= descriptor->dimsize[dimcount]) {
+        DEBUGFUNCMSGOUT;
+        error(ERR_BADINDEX, index, vp->varname);
+        return;
+      }
+      element = element*descriptor->dimsize[dimcount]+index;
+      dimcount++;
+      if (*basicvars.current != ',') break;     /* No more array indexes expected */
+      basicvars.current++;
+      if (dimcount >= maxdims) {  /* Too many dimensions */
+        DEBUGFUNCMSGOUT;
+        error(ERR_INDEXCO, vp->varname);
+        return;
+      }
+    } while (TRUE);
+    if (dimcount != maxdims) {   /* Not enough dimensions */
+      DEBUGFUNCMSGOUT;
+      error(ERR_INDEXCO, vp->varname);
+      return;
+    }
+    if ((maxdims == 2 || maxdims == 3) && *tp == BASTOKEN_ARRAYREF) patch_arrayref(tp, maxdims);
+  }
+  if (*basicvars.current != ')') {
+    DEBUGFUNCMSGOUT;
+    error(ERR_RPMISS);
+    return;
+  }
+  basicvars.current++;          /* Point at character after the ')' */
+  push_element(vp, element);
+  DEBUGFUNCMSGOUT;
+}
+
+/*
+** 'do_fastarrayref' handles references to elements of two and three
+** dimensional arrays where all of the indexes are simple integer
+** variables, for example, 'grid(x%,y%)'
+*/
+static void do_fastarrayref(void) {
+  variable *vp = GET_ADDRESS(basicvars.current, variable *);
+  int32 element;
+
+  DEBUGFUNCMSGIN;
+  element = fast_element(vp);
+  if (element < 0)
+    do_arrayref();
+  else {
+    push_element(vp, element);
+  }
+  DEBUGFUNCMSGOUT;
+}
+
 /*
 ** 'do_indrefvar' handles references to dynamic variables that
 ** are followed by indirection operators
@@ -1590,6 +1696,241 @@ static void *make_array(int32 arraytype, basicarray* original) {
   return base;
 }
 
+/*
+** The following code deals with the fused evaluation of whole-array
+** expressions such as 'A()=B()*2+C()'. Rather than evaluating each
+** operator in turn, creating a temporary array on the Basic stack for
+** each intermediate result, the expression is compiled into a short
+** postfix program which is then run over the arrays a block of elements
+** at a time with the final result written straight into the destination.
+** If the expression contains an operator that can fail, that is, '*' or
+** '/', the result is built in a block on the Basic stack instead and only
+** copied to the destination once every element has been worked out, so
+** that an error leaves the destination as it was. Only expressions made up of floating point arrays, numeric constants
+** and simple numeric variables combined with '+', '-', '*' and '/' are
+** handled here. Every operator must have at least one array operand so
+** that the results are the same as those of the general code
+*/
+#define FUSEDMAXITEMS 16                /* Maximum number of operands and operators in a fused expression */
+#define FUSEDBLOCK 256                  /* Number of array elements processed in each pass */
+
+typedef enum {FUSED_ARRAY, FUSED_SCALAR, FUSED_OPER} fusedkind;
+
+typedef struct {
+  fusedkind kind;
+  byte oper;                            /* Operator for FUSED_OPER items */
+  byte *where;                          /* Token of FUSED_SCALAR operand */
+  basicarray *array;                    /* Array descriptor for FUSED_ARRAY items */
+  float64 value;                        /* Value of FUSED_SCALAR operand */
+} fuseditem;
+
+typedef struct {
+  float64 *vec;                         /* Block of values or NIL if scalar */
+  float64 value;                        /* Value if scalar */
+} fusedvalue;
+
+/*
+** 'fused_operand' checks whether the token at 'p' is an operand that
+** can be used in a fused array expression, filling in 'item' if it is.
+** It returns a pointer to the token after the operand or NIL if the
+** operand cannot be handled. References to arrays that have not been
+** seen before are resolved here in the same way as 'do_xvar' does it.
+** The dimensions of the array are not checked here as the expression
+** might still turn out to be one that cannot be fused
+*/
+static byte *fused_operand(byte *p, fuseditem *item) {
+  variable *vp;
+  byte *base, *np;
+
+  switch (*p) {
+  case BASTOKEN_STATICVAR: case BASTOKEN_UINT8VAR: case BASTOKEN_INTVAR:
+  case BASTOKEN_INT64VAR: case BASTOKEN_FLOATVAR: case BASTOKEN_INTZERO:
+  case BASTOKEN_INTONE: case BASTOKEN_SMALLINT: case BASTOKEN_INTCON:
+  case BASTOKEN_FLOATZERO: case BASTOKEN_FLOATONE: case BASTOKEN_FLOATCON:
+  case BASTOKEN_INT64CON:
+    item->kind = FUSED_SCALAR;
+    item->where = p;
+    return skip_token(p);
+  case BASTOKEN_XVAR:
+    base = GET_SRCADDR(p);
+    np = skip_name(base);
+    if (*(np-1) == '$') return NIL;
+    if (*(np-1) != '(') {               /* Simple variable - Leave the factor code to resolve it */
+      item->kind = FUSED_SCALAR;
+      item->where = p;
+      return p+LOFFSIZE+1;
+    }
+    if (*(p+LOFFSIZE+1) != ')') return NIL;     /* Reference to an array element */
+    vp = find_variable(base, np-base);
+    if (vp == NIL || vp->varentry.vararray == NIL) return NIL;
+    *p = BASTOKEN_ARRAYVAR;
+    set_address(p, vp);
+    break;
+  case BASTOKEN_ARRAYVAR:
+    if (*(p+LOFFSIZE+1) != ')') return NIL;
+    vp = GET_ADDRESS(p, variable *);
+    break;
+  default:
+    return NIL;
+  }
+  if (vp->varflags != VAR_FLOATARRAY || vp->varentry.vararray == NIL) return NIL;
+  item->kind = FUSED_ARRAY;
+  item->array = vp->varentry.vararray;
+  return p+LOFFSIZE+2;
+}
+
+/*
+** 'fused_apply' carries out one operator of a fused array expression on
+** 'count' elements, storing the results at 'result'
+*/
+static void fused_apply(byte oper, float64 *result, fusedvalue *lh, fusedvalue *rh, int32 count) {
+  float64 lhval = lh->value, rhval = rh->value;
+  int32 n;
+
+#define FUSEDLOOP(expr) \
+  if (lh->vec != NIL && rh->vec != NIL) { \
+    for (n = 0; n < count; n++) {lhval = lh->vec[n]; rhval = rh->vec[n]; result[n] = expr;} \
+  } else if (lh->vec != NIL) { \
+    for (n = 0; n < count; n++) {lhval = lh->vec[n]; result[n] = expr;} \
+  } else { \
+    for (n = 0; n < count; n++) {rhval = rh->vec[n]; result[n] = expr;} \
+  }
+
+  switch (oper) {
+  case '+': FUSEDLOOP(lhval + rhval); break;
+  case '-': FUSEDLOOP(lhval - rhval); break;
+  case '*': FUSEDLOOP(fmulwithtest(lhval, rhval)); break;
+  case '/': FUSEDLOOP(fdivwithtest(lhval, rhval)); break;
+  }
+#undef FUSEDLOOP
+}
+
+/*
+** 'eval_fusedarray' is called when the destination of an assignment is
+** a floating point array. It checks if the expression at 'basicvars.current'
+** can be evaluated element by element straight into the destination array
+** 'dest' and does so if possible. It returns TRUE if the assignment has been
+** dealt with or FALSE if the general expression code has to be used.
+** Nothing is evaluated before the whole expression has been checked, but
+** references to arrays in it might have been resolved. Expressions where
+** an array does not have the same dimensions as 'dest' are left to the
+** general code as well, so that they behave exactly as before
+*/
+boolean eval_fusedarray(basicarray *dest) {
+  fuseditem items[FUSEDMAXITEMS];
+  byte opers[FUSEDMAXITEMS];
+  boolean isarray[FUSEDMAXITEMS];
+  fusedvalue values[FUSEDMAXITEMS];
+  float64 work[FUSEDMAXITEMS][FUSEDBLOCK];
+  float64 *resultbase;
+  boolean mayfail = FALSE;
+  int32 itemcount = 0, opcount = 0, depth = 0, arrays = 0, n, start, count;
+  byte *p = basicvars.current;
+
+  DEBUGFUNCMSGIN;
+  if (*p == ' ') p++;
+  while (TRUE) {        /* Convert the expression to postfix form */
+    fuseditem operand;
+    byte oper;
+    p = fused_operand(p, &operand);
+    if (p == NIL || itemcount == FUSEDMAXITEMS) {
+      DEBUGFUNCMSGOUT;
+      return FALSE;
+    }
+    if (operand.kind == FUSED_ARRAY) arrays++;
+    isarray[depth++] = operand.kind == FUSED_ARRAY;
+    items[itemcount++] = operand;
+    oper = *p;
+    if (oper != '+' && oper != '-' && oper != '*' && oper != '/') oper = 0;
+    while (opcount > 0 && (oper == 0 || oper == '+' || oper == '-' || opers[opcount-1] == '*' || opers[opcount-1] == '/')) {
+      if (itemcount == FUSEDMAXITEMS || !(isarray[depth-2] || isarray[depth-1])) {
+        DEBUGFUNCMSGOUT;
+        return FALSE;                   /* Operator with two scalar operands */
+      }
+      opcount--;
+      if (opers[opcount] == '*' || opers[opcount] == '/') mayfail = TRUE;
+      items[itemcount].kind = FUSED_OPER;
+      items[itemcount++].oper = opers[opcount];
+      depth--;
+      isarray[depth-1] = TRUE;
+    }
+    if (oper == 0) break;
+    opers[opcount++] = oper;
+    p++;
+  }
+  if (!isateol(p) || arrays == 0 || itemcount == 1) {
+    DEBUGFUNCMSGOUT;
+    return FALSE;
+  }
+  for (n = 0; n < itemcount; n++) {     /* Check the arrays match the destination */
+    basicarray *ap = items[n].array;
+    int32 dim;
+    if (items[n].kind != FUSED_ARRAY) continue;
+    if (ap->dimcount != dest->dimcount) {
+      DEBUGFUNCMSGOUT;
+      return FALSE;
+    }
+    for (dim = 0; dim < dest->dimcount; dim++) {
+      if (ap->dimsize[dim] != dest->dimsize[dim]) {
+        DEBUGFUNCMSGOUT;
+        return FALSE;
+      }
+    }
+  }
+  for (n = 0; n < itemcount; n++) {     /* Evaluate the scalar operands */
+    if (items[n].kind != FUSED_SCALAR) continue;
+    basicvars.current = items[n].where;
+    (*factor_table[*basicvars.current])();
+    if (!TOPITEMISNUM) {
+      DEBUGFUNCMSGOUT;
+      error(ERR_TYPENUM);
+      return FALSE;
+    }
+    items[n].value = pop_anynumfp();
+  }
+  basicvars.current = p;
+  resultbase = dest->arraystart.floatbase;
+  if (mayfail) {        /* Build the result on the stack so that an error leaves 'dest' alone */
+    resultbase = alloc_stackmem(dest->arrsize*sizeof(float64));
+    if (resultbase == NIL) {
+      DEBUGFUNCMSGOUT;
+      error(ERR_NOROOM);
+      return FALSE;
+    }
+  }
+  for (start = 0; start < dest->arrsize; start += FUSEDBLOCK) {
+    count = dest->arrsize - start;
+    if (count > FUSEDBLOCK) count = FUSEDBLOCK;
+    depth = 0;
+    for (n = 0; n < itemcount; n++) {
+      switch (items[n].kind) {
+      case FUSED_ARRAY:
+        values[depth].vec = items[n].array->arraystart.floatbase + start;
+        depth++;
+        break;
+      case FUSED_SCALAR:
+        values[depth].vec = NIL;
+        values[depth].value = items[n].value;
+        depth++;
+        break;
+      case FUSED_OPER: {
+          float64 *result = n == itemcount-1 ? resultbase + start : work[depth-2];
+          depth--;
+          fused_apply(items[n].oper, result, &values[depth-1], &values[depth], count);
+          values[depth-1].vec = result;
+        }
+        break;
+      }
+    }
+  }
+  if (mayfail) {
+    memmove(dest->arraystart.floatbase, resultbase, dest->arrsize*sizeof(float64));
+    free_stackmem();
+  }
+  DEBUGFUNCMSGOUT;
+  return TRUE;
+}
+
 /* This function subsumes the functionality of eval_ivplus, eval_ivminus,
 ** eval_ivmul, eval_ivdiv, eval_ivmod and eval_ivintdiv.
 */
@@ -4246,8 +4587,8 @@ void (*factor_table[256])(void) = {
   do_indrefvar, do_indrefvar,  do_statindvar, do_xfunction, /* 0C..0F */
   do_function,  do_intzero,    do_intone,     do_smallconst,/* 10..13 */
   do_intconst,  do_floatzero,  do_floatone,   do_floatconst,/* 14..17 */
-  do_stringcon, do_qstringcon, do_int64const, bad_token,    /* 18..1B */
-  bad_token,    bad_token,     bad_token,     bad_token,    /* 1C..1F */
+  do_stringcon, do_qstringcon, do_int64const, do_fastarrayref, /* 18..1B */
+  do_fastarrayref, bad_token,  bad_token,     bad_token,    /* 1C..1F */
   bad_token,    do_getword,    bad_syntax,    bad_syntax,   /* 20..23 */
   do_getstring, bad_syntax,    bad_syntax,    bad_syntax,   /* 24..27 */
   do_brackets,  bad_syntax,    bad_syntax,    do_unaryplus, /* 28..2B */
@@ -36,6 +36,9 @@ extern int64 eval_int64(void);
 extern int32 eval_intfactor(void);
 
 extern void check_arrays(basicarray *, basicarray *);
+extern void patch_arrayref(byte *, int32);
+extern int32 fast_element(variable *);
+extern boolean eval_fusedarray(basicarray *);
 extern void expression(void);
 extern void factor(void);
 extern void push_parameters(fnprocdef *, char *);
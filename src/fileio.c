@@ -53,22 +53,39 @@ typedef enum {CLOSED, OPENIN, OPENUP, OPENOUT, NETWORK} filestate;
 typedef enum {OKAY, PENDING, ATEOF} eofstate;
 
 typedef struct {
+#ifdef TARGET_RISCOS
   FILE *stream;                 /* 'C' file handle for the file */
+  boolean lastwaswrite;         /* TRUE if the last operation on a file was a write */
+#else
+  int fd;                       /* Operating system file descriptor */
+  byte *buffer;                 /* Buffer holding a window on to the file */
+  int64 bufstart;               /* Offset in file of first byte in buffer */
+  int32 bufpos;                 /* Offset in buffer of current file pointer */
+  int32 buflen;                 /* Number of valid bytes in buffer */
+  int32 bufsize;                /* Size of buffer */
+  int32 dirtystart;             /* Offset in buffer of first modified byte */
+  int32 dirtyend;               /* Offset in buffer after last modified byte (0 = none) */
+  int32 nextfree;               /* Index of next entry on free list if closed */
+#endif
   filestate filetype;           /* Way in which file has been opened */
   eofstate eofstatus;           /* Current end-of-file status */
-  boolean lastwaswrite;         /* TRUE if the last operation on a file was a write */
   int nethandle;                /* network handle */
 } fileblock;
 
 #ifdef TARGET_RISCOS
 #define MAXFILES 4              /* Maximum number of files that can be open simultaneously - only tracks networking on RISC OS */
 #define FIRSTHANDLE 4           /* Number of first handle */
+static fileblock fileinfo [MAXFILES+1];
 #else
-#define MAXFILES 256            /* Maximum number of files that can be open simultaneously */
+#define MAXFILES 4096           /* Default limit on the number of files that can be open simultaneously */
+#define INITFILES 16            /* Initial size of file table */
 #define FIRSTHANDLE 254         /* Number of first handle */
-#endif
 
-static fileblock fileinfo [MAXFILES+1];
+static fileblock *fileinfo;     /* Table of files, extended as more files are opened */
+static int32 filecount;         /* Number of entries in 'fileinfo' */
+static int32 maxfiles;          /* Maximum number of entries allowed in 'fileinfo' */
+static int32 firstfree;         /* Index of first unused entry in 'fileinfo' or -1 */
+#endif
 
 /*
 ** 'isapath' returns TRUE if the file name passed to it is a pathname, that
@@ -192,15 +209,26 @@ int32 fileio_openup(char *name, int32 namelen) {
   filename[namelen] = NUL;
 #ifndef NONET
   /* Check, does it start "ip4:" if so use network handler to open it. */
-  if (strncmp(filename, "ip0:", 4)==0 || strncmp(filename, "ip4:", 4)==0 || strncmp(filename, "ip6:", 4)==0) {
+  if (strncmp(filename, "ip0:", 4)==0 || strncmp(filename, "ip4:", 4)==0 || strncmp(filename, "ip6:", 4)==0
+   || strncmp(filename, "udp0:", 5)==0 || strncmp(filename, "udp4:", 5)==0 || strncmp(filename, "udp6:", 5)==0
+   || strncmp(filename, "unix:", 5)==0) {
     for (n=FIRSTHANDLE; n>0 && fileinfo[n].stream!=NIL; n--);   /* Find an unused handle */
-    handle=brandynet_connect(filename+4, filename[2], 1);
+    if (n==0) error(ERR_NET_MAXSOCKETS);
+    if (filename[1]=='n')       /* Unix domain socket. "unix::path" listens on it */
+      handle=brandynet_unix(filename[5]==':' ? filename+6 : filename+5, filename[5]==':', 1);
+    else if (filename[0]=='u')  /* UDP socket */
+      handle=brandynet_udp(filename+5, filename[3], 1);
+    else if (filename[4]==':')  /* No host name - Listen for connections on the port */
+      handle=brandynet_listen(filename+5, filename[2], 1);
+    else
+      handle=brandynet_connect(filename+4, filename[2], 1);
     if (handle == -1) return 0;
     fileinfo[n].stream = (void *)42; /* Not used, but != NIL */
     fileinfo[n].filetype = NETWORK;
     fileinfo[n].eofstatus = OKAY;
     fileinfo[n].lastwaswrite = FALSE;
     fileinfo[n].nethandle = handle;
+    brandynet_setowner(handle, n);
     return n;
   } else {
 #endif
@@ -225,6 +253,95 @@ int32 fileio_openup(char *name, int32 namelen) {
 #endif
 }
 
+#ifndef NONET
+/*
+** 'fileio_netaccept' picks up the next incoming connection on the
+** listening network handle 'handle'. It returns the handle for the
+** new connection or zero if there are no connections waiting
+*/
+int32 fileio_netaccept(int32 handle) {
+  int32 n;
+  int nethandle;
+
+  if (handle<=0 || handle>FIRSTHANDLE || fileinfo[handle].filetype!=NETWORK) error(ERR_BADHANDLE);
+  for (n=FIRSTHANDLE; n>0 && fileinfo[n].stream!=NIL; n--);     /* Find an unused handle */
+  if (n==0) error(ERR_NET_MAXSOCKETS);
+  nethandle = brandynet_accept(fileinfo[handle].nethandle);
+  if (nethandle == -1) return 0;
+  fileinfo[n].stream = (void *)42; /* Not used, but != NIL */
+  fileinfo[n].filetype = NETWORK;
+  fileinfo[n].eofstatus = OKAY;
+  fileinfo[n].lastwaswrite = FALSE;
+  fileinfo[n].nethandle = nethandle;
+  brandynet_setowner(nethandle, n);
+  return n;
+}
+
+/*
+** 'fileio_netconnect' starts a connection to the host named in 'name',
+** which has the same form as a host name passed to OPENUP, and returns
+** its handle without waiting for the connection to be made
+*/
+int32 fileio_netconnect(char *name) {
+  int32 n;
+  int handle;
+
+  if (strncmp(name, "ip0:", 4)!=0 && strncmp(name, "ip4:", 4)!=0 && strncmp(name, "ip6:", 4)!=0) error(ERR_NET_NOTFOUND);
+  for (n=FIRSTHANDLE; n>0 && fileinfo[n].stream!=NIL; n--);     /* Find an unused handle */
+  if (n==0) error(ERR_NET_MAXSOCKETS);
+  handle = brandynet_connect_async(name+4, name[2]);
+  fileinfo[n].stream = (void *)42; /* Not used, but != NIL */
+  fileinfo[n].filetype = NETWORK;
+  fileinfo[n].eofstatus = OKAY;
+  fileinfo[n].lastwaswrite = FALSE;
+  fileinfo[n].nethandle = handle;
+  brandynet_setowner(handle, n);
+  return n;
+}
+
+/*
+** 'fileio_netstatus' returns the state of the connection on network
+** handle 'handle'
+*/
+int32 fileio_netstatus(int32 handle) {
+  if (handle<=0 || handle>FIRSTHANDLE || fileinfo[handle].filetype!=NETWORK) error(ERR_BADHANDLE);
+  return brandynet_status(fileinfo[handle].nethandle);
+}
+
+/*
+** 'fileio_netflush' sends any data waiting to be sent on network handle
+** 'handle', or on all network handles if 'handle' is zero
+*/
+void fileio_netflush(int32 handle) {
+  if (handle==0) {
+    for (handle=FIRSTHANDLE; handle>0; handle--) {
+      if (fileinfo[handle].filetype==NETWORK) net_flush(fileinfo[handle].nethandle);
+    }
+    return;
+  }
+  if (handle<0 || handle>FIRSTHANDLE || fileinfo[handle].filetype!=NETWORK) error(ERR_BADHANDLE);
+  if (net_flush(fileinfo[handle].nethandle)) error(ERR_CANTWRITE);
+}
+
+/*
+** 'fileio_netoptions' changes the options for network handle 'handle'
+** to 'options', returning the old options
+*/
+int32 fileio_netoptions(int32 handle, int32 options) {
+  if (handle<=0 || handle>FIRSTHANDLE || fileinfo[handle].filetype!=NETWORK) error(ERR_BADHANDLE);
+  return net_options(fileinfo[handle].nethandle, options);
+}
+
+/*
+** 'fileio_netshutdown' sends any data waiting on network handle 'handle'
+** and then tells the other end that nothing more will be sent
+*/
+void fileio_netshutdown(int32 handle) {
+  if (handle<=0 || handle>FIRSTHANDLE || fileinfo[handle].filetype!=NETWORK) error(ERR_BADHANDLE);
+  if (brandynet_shutdown(fileinfo[handle].nethandle)) error(ERR_CANTWRITE);
+}
+#endif
+
 /*
 ** 'fileio_close' closes the fie given by 'handle' or all open files
 ** if 'handle' is zero
@@ -322,6 +439,34 @@ int32 fileio_getdol(int32 handle, char *buffer) {
   return length;
 }
 
+/*
+** 'fileio_getblock' reads up to 'count' bytes from file 'handle' at
+** the current file pointer into memory at 'address'. It returns the
+** number of bytes transferred, which is less than 'count' if the end
+** of the file is reached (or no more data is waiting on a network
+** connection)
+*/
+int32 fileio_getblock(int32 handle, byte *address, int32 count) {
+  _kernel_oserror *oserror;
+  _kernel_swi_regs regs;
+
+  if (handle==0) {
+    error(ERR_BADHANDLE);
+    return 0;
+  }
+  if (count<=0) return 0;
+#ifndef NONET
+  if ((handle <= FIRSTHANDLE) && (fileinfo[handle].filetype==NETWORK)) return net_read(fileinfo[handle].nethandle, CAST(address, char *), count);
+#endif
+  regs.r[0] = 4;        /* OS_GBPB 4 = read from file at current file pointer position */
+  regs.r[1] = handle;
+  regs.r[2] = TOINT((int)address);
+  regs.r[3] = count;
+  oserror = _kernel_swi(OS_GBPB, &regs, &regs);
+  if (oserror!=NIL) error(ERR_CMDFAIL, oserror->errmess);
+  return count-regs.r[3];
+}
+
 /*
 ** 'fileio_getnumber' reads a binary number from the file with
 ** handle 'handle'. It stores the result at the address given
@@ -478,6 +623,18 @@ void fileio_bputstr(int32 handle, char *string, int32 length) {
 #endif
 }
 
+/*
+** 'fileio_endwrite' is called at the end of a BPUT# or PRINT# statement.
+** Everything the statement wrote to a UDP network handle is sent as
+** one datagram
+*/
+void fileio_endwrite(int32 handle) {
+#ifndef NONET
+  if (handle<=0 || handle>FIRSTHANDLE || fileinfo[handle].filetype!=NETWORK) return;
+  if (net_endwrite(fileinfo[handle].nethandle)) error(ERR_CANTWRITE);
+#endif
+}
+
 /*
 ** 'fileio_printint' writes a four byte integer to a file in binary
 ** preceded with 0x40 to mark it as an integer.
@@ -554,6 +711,17 @@ int64 fileio_getptr(int32 handle) {
   return pointer;
 }
 
+/*
+** 'fileio_isnetwork' returns TRUE if 'handle' is a network handle
+*/
+boolean fileio_isnetwork(int32 handle) {
+#ifndef NONET
+  return handle>0 && handle<=FIRSTHANDLE && fileinfo[handle].filetype==NETWORK;
+#else
+  return FALSE;
+#endif
+}
+
 /*
 ** 'fileio_setptr' is used to set the current file pointer of
 ** the file 'handle'
@@ -615,41 +783,385 @@ void init_fileio(void) {
 /* ========= NetBSD/Linux/DOS/Windows versions of functions ========= */
 /* ================================================================== */
 
+#include <stdlib.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifdef TARGET_UNIX
+#include <sys/resource.h>
+#endif
+
 /*
-** Files are opened in character mode under RISC OS, Linux and NetBSD
-** as there is basically no difference between binary and character
-** modes with these operating systems. This is what we want as Basic
-** does not distinguish between these two types of file. Unfortunately
-** DOS has to be different. In character mode the DOS libraries I have
-** seen to like to stick 'carriage return' characters in the output
-** stream whenever they see a 'linefeed' when writing to a file. Under
-** DOS files are always treated as binary.
+** Files are accessed using the operating system's own file descriptors
+** rather than 'C' streams. Each open file has a buffer of its own that
+** holds a window on to the file that starts at offset 'bufstart'. BGET#,
+** BPUT#, PRINT# and INPUT# work directly on the buffer and only call
+** the operating system when the file pointer moves outside the window.
+** Modified bytes are tracked so that only they are written back.
+**
+** Under DOS and Windows files have to be opened in binary mode to stop
+** the libraries inserting 'carriage return' characters before every
+** 'linefeed'. Basic does not distinguish between the two types of file.
 */
-#if defined(TARGET_DOSWIN)
-#define INMODE "rb"
-#define OUTMODE "wb+"
-#define UPMODE "rb+"
-#else
-#define INMODE "r"
-#define OUTMODE "w+"
-#define UPMODE "r+"
+#ifndef O_BINARY
+#define O_BINARY 0
 #endif
 
+#define INMODE (O_RDONLY | O_BINARY)
+#define OUTMODE (O_RDWR | O_CREAT | O_TRUNC | O_BINARY)
+#define UPMODE (O_RDWR | O_BINARY)
+
+#define FILEBUFSIZE 65536       /* Size of the buffer attached to each file */
+
+/*
+** Basic-style file handles are allocated downwards from FIRSTHANDLE for
+** the first entries in the 'fileinfo' table, as on RISC OS, and upwards
+** from FIRSTHANDLE+1 for any after those. Unused entries are kept on a
+** free list so that finding one does not involve searching the table
+*/
+
 /*
 ** 'map_handle' maps a Basic-style file handle to the corresponding entry
 ** in the 'fileinfo' table and checks that the handle is valid
 */
 static int32 map_handle(int32 handle) {
-  handle = FIRSTHANDLE-handle;
-  if (handle<0 || handle>=MAXFILES || fileinfo[handle].filetype==CLOSED) error(ERR_BADHANDLE);
-  return handle;
+  int32 n = handle<=FIRSTHANDLE ? FIRSTHANDLE-handle : handle-1;
+  if (handle<=0 || n>=filecount || fileinfo[n].filetype==CLOSED) error(ERR_BADHANDLE);
+  return n;
+}
+
+/*
+** 'file_handle' returns the Basic-style file handle for entry 'n'
+** in the 'fileinfo' table
+*/
+static int32 file_handle(int32 n) {
+  return n<FIRSTHANDLE ? FIRSTHANDLE-n : n+1;
+}
+
+/*
+** 'find_slot' returns the index of an unused entry in the 'fileinfo'
+** table, making the table larger if there are none left. The entry
+** remains on the free list until 'claim_slot' is called once the file
+** has been opened successfully
+*/
+static int32 find_slot(void) {
+  if (firstfree==-1) {
+    fileblock *newinfo;
+    int32 n, newcount = filecount==0 ? INITFILES : filecount*2;
+    if (newcount>maxfiles) newcount = maxfiles;
+    if (newcount<=filecount) error(ERR_MAXHANDLE);
+    newinfo = realloc(fileinfo, newcount*sizeof(fileblock));
+    if (newinfo==NIL) error(ERR_MAXHANDLE);
+    fileinfo = newinfo;
+    for (n=filecount; n<newcount; n++) {
+      fileinfo[n].fd = -1;
+      fileinfo[n].buffer = NIL;
+      fileinfo[n].bufpos = fileinfo[n].buflen = fileinfo[n].bufsize = 0;
+      fileinfo[n].filetype = CLOSED;
+      fileinfo[n].eofstatus = ATEOF;
+      fileinfo[n].nextfree = n+1<newcount ? n+1 : -1;
+    }
+    firstfree = filecount;
+    filecount = newcount;
+  }
+  return firstfree;
+}
+
+/*
+** 'claim_slot' removes entry 'n', the one returned by the last call to
+** 'find_slot', from the free list and returns its file handle
+*/
+static int32 claim_slot(int32 n) {
+  firstfree = fileinfo[n].nextfree;
+  return file_handle(n);
+}
+
+/*
+** 'write_all' writes 'count' bytes from 'data' to the file at offset
+** 'position', retrying after partial writes. It returns FALSE if the
+** data could not be written
+*/
+static boolean write_all(int fd, byte *data, int32 count, int64 position) {
+  if (lseek(fd, position, SEEK_SET)==-1) return FALSE;
+  while (count>0) {
+    ssize_t result = write(fd, data, count);
+    if (result<0) {
+      if (errno==EINTR) continue;
+      return FALSE;
+    }
+    data+=result;
+    count-=result;
+  }
+  return TRUE;
+}
+
+/*
+** 'read_all' reads up to 'count' bytes from the file at offset 'position'
+** into 'data'. It returns the number of bytes read, which is only less
+** than 'count' at the end of the file or if the read failed
+*/
+static int32 read_all(int fd, byte *data, int32 count, int64 position) {
+  int32 total = 0;
+  if (lseek(fd, position, SEEK_SET)==-1) return 0;
+  while (total<count) {
+    ssize_t result = read(fd, data+total, count-total);
+    if (result<0 && errno==EINTR) continue;
+    if (result<=0) break;
+    total+=result;
+  }
+  return total;
+}
+
+/*
+** 'flush_buffer' writes any modified bytes in the buffer of file
+** 'fp' back to the file. The buffer contents are left intact. It
+** returns FALSE if the write failed. The modified range is cleared
+** whatever happens so that a failing file can still be closed
+*/
+static boolean flush_buffer(fileblock *fp) {
+  int32 start = fp->dirtystart, count = fp->dirtyend-fp->dirtystart;
+  if (count<=0) return TRUE;
+  fp->dirtystart = fp->dirtyend = 0;
+  return write_all(fp->fd, fp->buffer+start, count, fp->bufstart+start);
+}
+
+/*
+** 'move_window' discards the contents of the buffer of file 'fp',
+** writing back anything that has been changed first, and positions
+** the (empty) window at 'position'
+*/
+static void move_window(fileblock *fp, int64 position) {
+  if (!flush_buffer(fp)) error(ERR_CANTWRITE);
+  fp->bufstart = position;
+  fp->bufpos = fp->buflen = 0;
+}
+
+/*
+** 'alloc_buffer' gives file 'fp' a buffer. This is done the first time
+** the file is read from or written to so that files that are open but
+** idle do not tie up memory
+*/
+static void alloc_buffer(fileblock *fp) {
+  fp->buffer = malloc(FILEBUFSIZE);
+  if (fp->buffer==NIL) error(ERR_NOROOM);
+  fp->bufsize = FILEBUFSIZE;
+}
+
+/*
+** 'fill_buffer' is called when the buffer of file 'fp' has been
+** exhausted. It loads the next part of the file into the buffer
+** and returns the number of bytes now available to read, which
+** will be zero at the end of the file
+*/
+static int32 fill_buffer(fileblock *fp) {
+  move_window(fp, fp->bufstart+fp->bufpos);
+  if (fp->buffer==NIL) alloc_buffer(fp);
+  fp->buflen = read_all(fp->fd, fp->buffer, fp->bufsize, fp->bufstart);
+  return fp->buflen;
+}
+
+/*
+** 'read_bytes' copies up to 'count' bytes from the file 'fp' to 'data'.
+** It returns the number of bytes read, which will be less than 'count'
+** if the end of the file is reached
+*/
+static int32 read_bytes(fileblock *fp, byte *data, int32 count) {
+  int32 total = 0;
+  while (total<count) {
+    int32 available = fp->buflen-fp->bufpos;
+    if (available<=0) {
+      if (count-total>=FILEBUFSIZE) {   /* Large read - Bypass the buffer */
+        int32 result;
+        move_window(fp, fp->bufstart+fp->bufpos);
+        result = read_all(fp->fd, data+total, count-total, fp->bufstart);
+        fp->bufstart+=result;
+        return total+result;
+      }
+      available = fill_buffer(fp);
+      if (available==0) break;
+    }
+    if (available>count-total) available = count-total;
+    memcpy(data+total, fp->buffer+fp->bufpos, available);
+    fp->bufpos+=available;
+    total+=available;
+  }
+  return total;
+}
+
+/*
+** 'read_byte' returns the next byte from file 'fp' for INPUT#, reporting
+** an error if the end of the file has been reached
+*/
+static int32 read_byte(fileblock *fp) {
+  if (fp->bufpos>=fp->buflen && fill_buffer(fp)==0) error(ERR_CANTREAD);
+  return fp->buffer[fp->bufpos++];
+}
+
+/*
+** 'write_bytes' copies 'count' bytes from 'data' to file 'fp' at the
+** current file pointer, extending the file if necessary
+*/
+static void write_bytes(fileblock *fp, byte *data, int32 count) {
+#ifndef NONET
+  if (fp->filetype==NETWORK) {
+    if (net_bputstr(fp->nethandle, CAST(data, char *), count)) error(ERR_CANTWRITE);
+    return;
+  }
+#endif
+  while (count>0) {
+    int32 room;
+    if (fp->bufpos>=fp->bufsize) move_window(fp, fp->bufstart+fp->bufpos);
+    if (fp->bufpos==0 && count>=FILEBUFSIZE) {  /* Large write - Bypass the buffer */
+      move_window(fp, fp->bufstart);
+      if (!write_all(fp->fd, data, count, fp->bufstart)) error(ERR_CANTWRITE);
+      fp->bufstart+=count;
+      return;
+    }
+    if (fp->buffer==NIL) alloc_buffer(fp);
+    room = fp->bufsize-fp->bufpos;
+    if (room>count) room = count;
+    memcpy(fp->buffer+fp->bufpos, data, room);
+    if (fp->dirtyend==0) fp->dirtystart = fp->bufpos;
+    else if (fp->bufpos<fp->dirtystart) fp->dirtystart = fp->bufpos;
+    fp->bufpos+=room;
+    if (fp->bufpos>fp->dirtyend) fp->dirtyend = fp->bufpos;
+    if (fp->bufpos>fp->buflen) fp->buflen = fp->bufpos;
+    data+=room;
+    count-=room;
+  }
+}
+
+/*
+** 'open_file' tries to open the file 'filename' with open mode 'mode'.
+** It returns the file descriptor or -1 if the file cannot be opened
+*/
+static int open_file(char *filename, int mode) {
+  int fd;
+  do {
+    fd = open(filename, mode, 0666);
+  } while (fd==-1 && errno==EINTR);
+  return fd;
+}
+
+/*
+** 'setup_file' fills in the 'fileinfo' entry 'n' for the newly opened
+** file 'fd' and returns its handle
+*/
+static int32 setup_file(int32 n, int fd, filestate filetype) {
+  fileblock *fp = &fileinfo[n];
+  fp->fd = fd;
+  fp->filetype = filetype;
+  fp->eofstatus = OKAY;
+  fp->bufstart = 0;
+  fp->bufpos = fp->buflen = 0;
+  fp->dirtystart = fp->dirtyend = 0;
+  fp->buffer = NIL;
+  fp->bufsize = 0;
+  return claim_slot(n);
+}
+
+#ifndef NONET
+/*
+** 'setup_network' fills in the 'fileinfo' entry 'n' for network
+** connection 'nethandle' and returns its handle
+*/
+static int32 setup_network(int32 n, int nethandle) {
+  fileblock *fp = &fileinfo[n];
+  fp->fd = -1;
+  fp->buffer = NIL;
+  fp->bufpos = fp->buflen = fp->bufsize = 0;
+  fp->filetype = NETWORK;
+  fp->eofstatus = OKAY;
+  fp->nethandle = nethandle;
+  n = claim_slot(n);
+  brandynet_setowner(nethandle, n);
+  return n;
+}
+
+/*
+** 'fileio_netaccept' picks up the next incoming connection on the
+** listening network handle 'handle'. It returns the handle for the
+** new connection or zero if there are no connections waiting
+*/
+int32 fileio_netaccept(int32 handle) {
+  int32 n;
+  int nethandle;
+
+  handle = map_handle(handle);
+  if (fileinfo[handle].filetype!=NETWORK) error(ERR_NET_NOTSUPP);
+  n = find_slot();
+  nethandle = brandynet_accept(fileinfo[handle].nethandle);
+  if (nethandle == -1) return 0;
+  return setup_network(n, nethandle);
+}
+
+/*
+** 'fileio_netconnect' starts a connection to the host named in 'name',
+** which has the same form as a host name passed to OPENUP, and returns
+** its handle without waiting for the connection to be made
+*/
+int32 fileio_netconnect(char *name) {
+  int32 n;
+
+  if (strncmp(name, "ip0:", 4)!=0 && strncmp(name, "ip4:", 4)!=0 && strncmp(name, "ip6:", 4)!=0) error(ERR_NET_NOTFOUND);
+  n = find_slot();
+  return setup_network(n, brandynet_connect_async(name+4, name[2]));
+}
+
+/*
+** 'fileio_netstatus' returns the state of the connection on network
+** handle 'handle'
+*/
+int32 fileio_netstatus(int32 handle) {
+  handle = map_handle(handle);
+  if (fileinfo[handle].filetype!=NETWORK) error(ERR_NET_NOTSUPP);
+  return brandynet_status(fileinfo[handle].nethandle);
+}
+
+/*
+** 'fileio_netflush' sends any data waiting to be sent on network handle
+** 'handle', or on all network handles if 'handle' is zero
+*/
+void fileio_netflush(int32 handle) {
+  if (handle==0) {
+    int32 n;
+    for (n=0; n<filecount; n++) {
+      if (fileinfo[n].filetype==NETWORK) net_flush(fileinfo[n].nethandle);
+    }
+    return;
+  }
+  handle = map_handle(handle);
+  if (fileinfo[handle].filetype!=NETWORK) error(ERR_NET_NOTSUPP);
+  if (net_flush(fileinfo[handle].nethandle)) error(ERR_CANTWRITE);
+}
+
+/*
+** 'fileio_netoptions' changes the options for network handle 'handle'
+** to 'options', returning the old options
+*/
+int32 fileio_netoptions(int32 handle, int32 options) {
+  handle = map_handle(handle);
+  if (fileinfo[handle].filetype!=NETWORK) error(ERR_NET_NOTSUPP);
+  return net_options(fileinfo[handle].nethandle, options);
 }
 
+/*
+** 'fileio_netshutdown' sends any data waiting on network handle 'handle'
+** and then closes the sending side of the connection. For a "pipe:"
+** handle this means that the command sees the end of its input
+*/
+void fileio_netshutdown(int32 handle) {
+  handle = map_handle(handle);
+  if (fileinfo[handle].filetype!=NETWORK) error(ERR_NET_NOTSUPP);
+  if (brandynet_shutdown(fileinfo[handle].nethandle)) error(ERR_CANTWRITE);
+}
+#endif
+
 /*
 ** 'fileio_openin' opens a file for input
 */
 int32 fileio_openin(char *name, int32 namelen) {
-  FILE *thefile;
+  int thefile;
   int32 n;
   char filename [FNAMESIZE];
 
@@ -657,27 +1169,23 @@ int32 fileio_openin(char *name, int32 namelen) {
     error(ERR_INVALIDFNAME);
     return 0;
   }
-  for (n=0; n<MAXFILES && fileinfo[n].stream!=NIL; n++);        /* Find an unused handle */
-  if (n>=MAXFILES) {
-    error(ERR_MAXHANDLE);
-    return 0;
-  }
+  n = find_slot();
   memmove(filename, name, namelen);
   filename[namelen] = asc_NUL;
-  thefile = fopen(filename, INMODE);
-  if (thefile==NIL) {
+  thefile = open_file(filename, INMODE);
+  if (thefile==-1) {
     char filenameb[FNAMESIZE];
     STRLCPY(filenameb, filename, FNAMESIZE);
     /* Append a .bbc suffix and try again */
     STRLCAT(filenameb, ".bbc", FNAMESIZE);
-    thefile = fopen(filenameb, INMODE);
-    if (thefile==NIL) {
+    thefile = open_file(filenameb, INMODE);
+    if (thefile==-1) {
       if (matrixflags.translatefname == 0) {
         return 0;
       } else {
         char *tfilename = translatefname(filename);
-        thefile = fopen(tfilename, INMODE);
-        if (thefile==NIL) {
+        thefile = open_file(tfilename, INMODE);
+        if (thefile==-1) {
           return 0; /* Could not open file - Return null handle */
         } else {
           /* We had to translate so set flags to always translate on save */
@@ -686,22 +1194,17 @@ int32 fileio_openin(char *name, int32 namelen) {
       }
     }
   }
-  fileinfo[n].stream = thefile;
-  fileinfo[n].filetype = OPENIN;
-  fileinfo[n].eofstatus = OKAY;
-  fileinfo[n].lastwaswrite = FALSE;
-  return FIRSTHANDLE-n;
+  return setup_file(n, thefile, OPENIN);
 }
 
 /*
 ** 'fileio_openout' opens file 'name' for output, creating the
 ** file (or recreating it if it already exists).
-** Note that the file is opened with mode "w+" so that it can be
-** both written to and read from. RISC OS allows files opened for
-** output to be read from as well
+** Note that the file is opened for both reading and writing.
+** RISC OS allows files opened for output to be read from as well
 */
 int32 fileio_openout(char *name, int32 namelen) {
-  FILE *thefile;
+  int thefile;
   int32 n;
   char filename [FNAMESIZE];
 
@@ -709,28 +1212,20 @@ int32 fileio_openout(char *name, int32 namelen) {
     error(ERR_INVALIDFNAME);
     return 0;
   }
-  for (n=0; n<MAXFILES && fileinfo[n].stream!=NIL; n++);        /* Find an unused handle */
-  if (n>=MAXFILES) {
-    error(ERR_MAXHANDLE);
-    return 0;
-  }
+  n = find_slot();
   memmove(filename, name, namelen);
   filename[namelen] = asc_NUL;
   if(matrixflags.translatefname == 1) {
     char *tfilename = translatefname(filename);
-    thefile = fopen(tfilename, OUTMODE);
+    thefile = open_file(tfilename, OUTMODE);
   } else {
-    thefile = fopen(filename, OUTMODE);
+    thefile = open_file(filename, OUTMODE);
   }
-  if (thefile==NIL) {
+  if (thefile==-1) {
     error(ERR_OPENWRITE, filename);
     return 0;
   }
-  fileinfo[n].stream = thefile;
-  fileinfo[n].filetype = OPENOUT;
-  fileinfo[n].eofstatus = OKAY;
-  fileinfo[n].lastwaswrite = FALSE;
-  return FIRSTHANDLE-n;
+  return setup_file(n, thefile, OPENOUT);
 }
 
 /*
@@ -738,7 +1233,7 @@ int32 fileio_openout(char *name, int32 namelen) {
 ** already. The file can both be read from and written to
 */
 int32 fileio_openup(char *name, int32 namelen) {
-  FILE *thefile;
+  int thefile;
   int32 n;
   char filename [FNAMESIZE];
   char filenameb[FNAMESIZE];
@@ -748,39 +1243,41 @@ int32 fileio_openup(char *name, int32 namelen) {
     error(ERR_INVALIDFNAME);
     return 0;
   }
-  for (n=0; n<MAXFILES && fileinfo[n].stream!=NIL; n++);        /* Find an unused handle */
-  if (n>=MAXFILES) {
-    error(ERR_MAXHANDLE);
-    return 0;
-  }
+  n = find_slot();
   memmove(filename, name, namelen);
   filename[namelen] = asc_NUL;
 #ifndef NONET
   /* Check, does it start "ip4:" if so use network handler to open it. */
-  if (!strncmp(filename, "ip0:", 4) || !strncmp(filename, "ip4:", 4) || !strncmp(filename, "ip6:", 4)) {
+  if (!strncmp(filename, "ip0:", 4) || !strncmp(filename, "ip4:", 4) || !strncmp(filename, "ip6:", 4)
+   || !strncmp(filename, "udp0:", 5) || !strncmp(filename, "udp4:", 5) || !strncmp(filename, "udp6:", 5)
+   || !strncmp(filename, "unix:", 5) || !strncmp(filename, "pipe:", 5)) {
     int handle;
-    handle=brandynet_connect(filename+4, filename[2], 1);
+    if (filename[0]=='p')       /* Command to run with its input and output connected to the handle */
+      handle=brandynet_pipe(filename+5, 1);
+    else if (filename[1]=='n')  /* Unix domain socket. "unix::path" listens on it */
+      handle=brandynet_unix(filename[5]==':' ? filename+6 : filename+5, filename[5]==':', 1);
+    else if (filename[0]=='u')  /* UDP socket */
+      handle=brandynet_udp(filename+5, filename[3], 1);
+    else if (filename[4]==':')  /* No host name - Listen for connections on the port */
+      handle=brandynet_listen(filename+5, filename[2], 1);
+    else
+      handle=brandynet_connect(filename+4, filename[2], 1);
     if (handle == -1) return 0;
-    fileinfo[n].stream = (void *)42; /* Not used, but != NIL */
-    fileinfo[n].filetype = NETWORK;
-    fileinfo[n].eofstatus = OKAY;
-    fileinfo[n].lastwaswrite = FALSE;
-    fileinfo[n].nethandle = handle;
-    return FIRSTHANDLE-n;
+    return setup_network(n, handle);
   } else {
 #endif
-    thefile = fopen(filename, UPMODE);
-    if (thefile==NIL) {
+    thefile = open_file(filename, UPMODE);
+    if (thefile==-1) {
       STRLCPY(filenameb, filename, FNAMESIZE);
       STRLCAT(filenameb, ".bbc", FNAMESIZE); /* Append a .bbc suffix and try again */
-      thefile = fopen(filenameb, UPMODE);
-      if (thefile==NIL) {
+      thefile = open_file(filenameb, UPMODE);
+      if (thefile==-1) {
         if (matrixflags.translatefname == 0) {
           return 0;
         } else {
           tfilename=translatefname(filename);
-          thefile = fopen(tfilename, UPMODE);
-          if (thefile==NIL) {
+          thefile = open_file(tfilename, UPMODE);
+          if (thefile==-1) {
             return 0; /* Could not open file - Return null handle */
           } else {
             /* We had to translate so set flags to always translate on save */
@@ -789,36 +1286,39 @@ int32 fileio_openup(char *name, int32 namelen) {
         }
       }
     }
-    fileinfo[n].stream = thefile;
-    fileinfo[n].filetype = OPENUP;
-    fileinfo[n].eofstatus = OKAY;
-    fileinfo[n].lastwaswrite = FALSE;
-    return FIRSTHANDLE-n;
+    return setup_file(n, thefile, OPENUP);
 #ifndef NONET
   }
 #endif
 }
 
 /*
-** 'close_file' is a function used locally to close a file or network channel
+** 'close_file' is a function used locally to close a file or network channel.
+** The entry is marked as closed before any error writing out the buffer
+** is reported
 */
 static void close_file(int32 handle) {
+  fileblock *fp = &fileinfo[handle];
+  boolean written = TRUE;
 #ifndef NONET
-  if ((handle <= FIRSTHANDLE) && (fileinfo[handle].filetype == NETWORK)) {
-    brandynet_close(fileinfo[handle].nethandle);
-    fileinfo[handle].stream = NIL;
-    fileinfo[handle].filetype = CLOSED;
-    fileinfo[handle].lastwaswrite = FALSE;
-    fileinfo[handle].nethandle = -1;
+  if (fp->filetype == NETWORK) {
+    brandynet_close(fp->nethandle);
+    fp->nethandle = -1;
   } else {
 #endif
-    fclose(fileinfo[handle].stream);
-    fileinfo[handle].stream = NIL;
-    fileinfo[handle].filetype = CLOSED;
-    fileinfo[handle].lastwaswrite = FALSE;
+    written = flush_buffer(fp);
+    if (close(fp->fd)==-1) written = FALSE;
 #ifndef NONET
   }
 #endif
+  free(fp->buffer);
+  fp->fd = -1;
+  fp->buffer = NIL;
+  fp->bufpos = fp->buflen = fp->bufsize = 0;
+  fp->filetype = CLOSED;
+  fp->nextfree = firstfree;     /* Put entry back on the free list */
+  firstfree = handle;
+  if (!written) error(ERR_CANTWRITE);
 }
 
 /*
@@ -828,7 +1328,7 @@ static void close_file(int32 handle) {
 void fileio_close(int32 handle) {
   int32 n;
   if (handle==0) {      /* Close all open files */
-    for (n=0; n<MAXFILES; n++) {
+    for (n=0; n<filecount; n++) {
       if (fileinfo[n].filetype!=CLOSED) close_file(n);
     }
   }
@@ -843,8 +1343,10 @@ void fileio_close(int32 handle) {
 ** Note that RISC OS allows you to read from a file that has been opened for
 ** writing. One byte can be read. The next attempt to read anything will
 ** result in an end-of-file error.
+** The common case of a byte already being in the buffer is dealt with first
 */
 int32 fileio_bget(int32 handle) {
+  fileblock *fp;
   int32 ch;
 
   if (handle==0) {
@@ -852,38 +1354,36 @@ int32 fileio_bget(int32 handle) {
     return 0;
   }
   handle = map_handle(handle);
+  fp = &fileinfo[handle];
+  if (fp->bufpos<fp->buflen && fp->eofstatus==OKAY && fp->filetype!=OPENOUT) return fp->buffer[fp->bufpos++];
 #ifndef NONET
-  if (fileinfo[handle].filetype == NETWORK) {
-    ch=net_bget(fileinfo[handle].nethandle);
+  if (fp->filetype == NETWORK) {
+    ch=net_bget(fp->nethandle);
     if (ch == -2) {
-      if (fileinfo[handle].eofstatus == PENDING) {
-        fileinfo[handle].eofstatus = ATEOF;
+      if (fp->eofstatus == PENDING) {
+        fp->eofstatus = ATEOF;
         error(ERR_HITEOF);
         return 0;
       } else {
-        fileinfo[handle].eofstatus = PENDING;
+        fp->eofstatus = PENDING;
       }
     }
   } else {
 #endif
-    if (fileinfo[handle].eofstatus!=OKAY) {     /* If EOF is pending, flag an error */
-      fileinfo[handle].eofstatus = ATEOF;
+    if (fp->eofstatus!=OKAY) {  /* If EOF is pending, flag an error */
+      fp->eofstatus = ATEOF;
       error(ERR_HITEOF);
       return 0;
     }
-    else if (fileinfo[handle].filetype==OPENOUT) {      /* If file is open for output, read one char */
-      fileinfo[handle].eofstatus = PENDING;
-    }
-    if (fileinfo[handle].lastwaswrite) {                /* Ensure everything has been written to disk first */
-      fflush(fileinfo[handle].stream);
-      fileinfo[handle].lastwaswrite = FALSE;
+    else if (fp->filetype==OPENOUT) {   /* If file is open for output, read one char */
+      fp->eofstatus = PENDING;
     }
-    ch = fgetc(fileinfo[handle].stream);        /* Read a character */
-    if (ch==EOF) {
-      fileinfo[handle].eofstatus = PENDING;     /* If call returns 'EOF' set 'PENDING EOF' flag */
+    if (fp->bufpos<fp->buflen || fill_buffer(fp)>0)
+      ch = fp->buffer[fp->bufpos++];    /* Read a character */
+    else {
+      fp->eofstatus = PENDING;  /* If at end of file set 'PENDING EOF' flag */
       ch = 0;
     }
-    fileinfo[handle].lastwaswrite = FALSE;
 #ifndef NONET
   }
 #endif
@@ -898,46 +1398,67 @@ int32 fileio_bget(int32 handle) {
 ** characters). Note that there is no check on the size of the buffer
 ** so it is up to the functions that call this one to ensure that the
 ** buffer is large enough to hold MAXSTRING (65536) characters.
+** The line is copied straight out of the file buffer a block at a time
 */
 int32 fileio_getdol(int32 handle, char *buffer) {
-  char *p;
+  fileblock *fp;
   int32 length;
+  boolean gotlf;
 
   if (handle==0) {
     error(ERR_BADHANDLE);
     return 0;
   }
   handle = map_handle(handle);
-  if (fileinfo[handle].eofstatus!=OKAY) {       /* If EOF is pending or EOF, flag an error */
-    fileinfo[handle].eofstatus = ATEOF;
+  fp = &fileinfo[handle];
+  if (fp->eofstatus!=OKAY) {    /* If EOF is pending or EOF, flag an error */
+    fp->eofstatus = ATEOF;
     error(ERR_HITEOF);
     return 0;
   }
-  if (fileinfo[handle].lastwaswrite) {          /* Ensure everything has been written to disk first */
-    fflush(fileinfo[handle].stream);
-    fileinfo[handle].lastwaswrite = FALSE;
+#ifndef NONET
+  if (fp->filetype==NETWORK) {  /* Return what has arrived of the line or datagram */
+    length = net_getline(fp->nethandle, buffer, MAXSTRING-1);
+    buffer[length] = asc_NUL;
+    if (length>0 && buffer[length-1]==asc_LF) {
+      length--;
+      if (length>0 && buffer[length-1]==asc_CR) length--;
+    }
+    return length;
+  }
+#endif
+  length = 0;
+  gotlf = FALSE;
+  while (!gotlf && length<MAXSTRING-1) {
+    int32 count = fp->buflen-fp->bufpos;
+    byte *start, *lf;
+    if (count<=0) {
+      count = fill_buffer(fp);
+      if (count==0) break;
+    }
+    if (count>MAXSTRING-1-length) count = MAXSTRING-1-length;
+    start = fp->buffer+fp->bufpos;
+    lf = memchr(start, asc_LF, count);
+    if (lf!=NIL) {
+      count = lf-start+1;
+      gotlf = TRUE;
+    }
+    memcpy(buffer+length, start, count);
+    fp->bufpos+=count;
+    length+=count;
   }
-  p = fgets(buffer, MAXSTRING, fileinfo[handle].stream);
-  if (p==NIL) {
+  if (length==0) {
     error(ERR_CANTREAD);      /* Read failed utterly */
     return 0;
   }
-  length = strlen(buffer);
-  p = buffer+length-1;  /* Point at line end character */
-  if (*p==asc_LF) {     /* Got a 'linefeed' at the end of the line */
+  buffer[length] = asc_NUL;
+  if (gotlf) {          /* Got a 'linefeed' at the end of the line */
     length--;
-    if (length>0 && *(p-1)==asc_CR) length--;   /* Got a 'carriage return-linefeed' pair */
+    if (length>0 && buffer[length-1]==asc_CR) length--; /* Got a 'carriage return-linefeed' pair */
   }
   return length;
 }
 
-static int32 fileio_read(FILE *handle) {
-  int32 ch;
-  ch = fgetc(handle);
-  if (ch==EOF) error(ERR_CANTREAD);
-  return ch;
-}
-
 /*
 ** 'fileio_getnumber' reads a binary number from the file with
 ** handle 'handle'. It stores the result at the address given
@@ -954,8 +1475,9 @@ static int32 fileio_read(FILE *handle) {
 ** byte floating point format
 */
 void fileio_getnumber(int32 handle, boolean *isint, int64 *ip, float64 *fp) {
-  FILE *stream;
+  fileblock *file;
   int32 n, marker;
+  byte data[sizeof(int64)];
   char temp[sizeof(float64)];
 
   memset(temp,0,sizeof(float64));
@@ -964,56 +1486,52 @@ void fileio_getnumber(int32 handle, boolean *isint, int64 *ip, float64 *fp) {
     return;
   }
   handle = map_handle(handle);
-  if (fileinfo[handle].eofstatus!=OKAY) {       /* If EOF is pending, flag an error */
-    fileinfo[handle].eofstatus = ATEOF;
+  file = &fileinfo[handle];
+  if (file->eofstatus!=OKAY) {  /* If EOF is pending, flag an error */
+    file->eofstatus = ATEOF;
     error(ERR_HITEOF);
     return;
   }
-  if (fileinfo[handle].lastwaswrite) {  /* Ensure everything has been written to disk first */
-    fflush(fileinfo[handle].stream);
-    fileinfo[handle].lastwaswrite = FALSE;
-  }
-  stream = fileinfo[handle].stream;
-  marker = fileio_read(stream);
+  marker = read_byte(file);
   switch (marker) {
   case PRINT_INT:
-    *ip = 0;
-    for (n=24; n>=0; n-=8) *ip |= fileio_read(stream) << n;
+    if (read_bytes(file, data, sizeof(int32))!=sizeof(int32)) error(ERR_CANTREAD);
+    *ip = (int32)((data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3]);
     *isint = TRUE;
     break;
   case PRINT_UINT8:
-    *ip = fileio_read(stream);
+    *ip = read_byte(file);
     *isint = TRUE;
     break;
   case PRINT_INT64:
+    if (read_bytes(file, data, sizeof(int64))!=sizeof(int64)) error(ERR_CANTREAD);
     *ip = 0;
-    for (n=56; n>=0; n-=8) *ip |= (int64)fileio_read(stream) << n;
+    for (n=0; n<sizeof(int64); n++) *ip = (*ip << 8) | data[n];
     *isint = TRUE;
     break;
   case PRINT_FLOAT:
+    if (read_bytes(file, data, sizeof(float64))!=sizeof(float64)) error(ERR_CANTREAD);
     switch (double_type) {
     case XMIXED_ENDIAN:
-      for (n=0; n<sizeof(float64); n++) temp[n] = fileio_read(stream);
+      for (n=0; n<sizeof(float64); n++) temp[n] = data[n];
       break;
     case XLITTLE_ENDIAN:
-      for (n=0; n<sizeof(float64); n++) temp[n^4] = fileio_read(stream);
+      for (n=0; n<sizeof(float64); n++) temp[n^4] = data[n];
       break;
     case XBIG_ENDIAN:
-      for (n=0; n<sizeof(float64); n++) temp[n^3] = fileio_read(stream);
+      for (n=0; n<sizeof(float64); n++) temp[n^3] = data[n];
       break;
     case XBIG_MIXED_ENDIAN:
-      for (n=0; n<sizeof(float64); n++) temp[n^7] = fileio_read(stream);
+      for (n=0; n<sizeof(float64); n++) temp[n^7] = data[n];
     }
     memmove(fp, temp, sizeof(float64));
     *isint = FALSE;
     break;
   case PRINT_FLOAT5: { /* Acorn's five byte format */
-    int32 exponent;
-    int32 mantissa = fileio_read(stream);
-    mantissa |= fileio_read(stream) << 8;
-    mantissa |= fileio_read(stream) << 16;
-    mantissa |= fileio_read(stream) << 24;
-    exponent = fileio_read(stream);
+    int32 exponent, mantissa;
+    if (read_bytes(file, data, 5)!=5) error(ERR_CANTREAD);
+    mantissa = data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+    exponent = data[4];
     if (exponent || mantissa) {
       *fp = ((mantissa & 0x7FFFFFFF) / 4294967296.0 + 0.5)
             * pow (2, exponent - 0x80)
@@ -1039,34 +1557,37 @@ void fileio_getnumber(int32 handle, boolean *isint, int64 *ip, float64 *fp) {
 ** that is, the last character of the string is first.
 */
 int32 fileio_getstring(int32 handle, char *p) {
-  FILE *stream;
+  fileblock *fp;
   int32 marker, length = 0, n;
+  byte data[sizeof(int32)];
 
   if (handle==0) {
     error(ERR_BADHANDLE);
     return 0;
   }
   handle = map_handle(handle);
-  if (fileinfo[handle].eofstatus!=OKAY) {       /* If EOF is pending, flag an error */
-    fileinfo[handle].eofstatus = ATEOF;
+  fp = &fileinfo[handle];
+  if (fp->eofstatus!=OKAY) {    /* If EOF is pending, flag an error */
+    fp->eofstatus = ATEOF;
     error(ERR_HITEOF);
     return 0;
   }
-  if (fileinfo[handle].lastwaswrite) {          /* Ensure everything has been written to disk first */
-    fflush(fileinfo[handle].stream);
-    fileinfo[handle].lastwaswrite = FALSE;
-  }
-  stream = fileinfo[handle].stream;
-  marker = fileio_read(stream);
+  marker = read_byte(fp);
   switch (marker) {
   case PRINT_SHORTSTR:  /* Reading short string in 'Acorn' format */
-    length = fileio_read(stream);
-    for (n=1; n<=length; n++) p[length-n] = fileio_read(stream);
+    length = read_byte(fp);
+    if (read_bytes(fp, CAST(p, byte *), length)!=length) error(ERR_CANTREAD);
+    for (n=0; n<length/2; n++) {        /* Put characters back in the right order */
+      char ch = p[n];
+      p[n] = p[length-1-n];
+      p[length-1-n] = ch;
+    }
     break;
   case PRINT_LONGSTR:   /* Reading long string */
     length = 0;         /* Start by reading the string length (four bytes, little endian) */
-    for (n=0; n<sizeof(int32); n++) length+=fileio_read(stream)<<(n*BYTESHIFT);
-    for (n=0; n<length; n++) p[n] = fileio_read(stream);
+    if (read_bytes(fp, data, sizeof(int32))!=sizeof(int32)) error(ERR_CANTREAD);
+    for (n=0; n<sizeof(int32); n++) length+=data[n]<<(n*BYTESHIFT);
+    if (read_bytes(fp, CAST(p, byte *), length)!=length) error(ERR_CANTREAD);
     break;
   default:
     error(ERR_TYPESTR);
@@ -1074,39 +1595,38 @@ int32 fileio_getstring(int32 handle, char *p) {
   return length;
 }
 
-static void fileio_write(FILE *stream, int32 value) {
-  int32 result;
-  result = fputc(value, stream);
-  if (result==EOF) error(ERR_CANTWRITE);
-}
-
 /*
-** 'fileio_bput' writes a character to a file
+** 'fileio_bput' writes a character to a file. The byte is stored
+** straight into the buffer if there is room for it
 */
 void fileio_bput(int32 handle, int32 value) {
-  int32 result;
+  fileblock *fp;
 
   if (handle==0) {
     error(ERR_BADHANDLE);
     return;
   }
   handle = map_handle(handle);
+  fp = &fileinfo[handle];
 #ifndef NONET
-  if (fileinfo[handle].filetype==NETWORK) {
-    if(net_bput(fileinfo[handle].nethandle, value)) error(ERR_CANTWRITE);
+  if (fp->filetype==NETWORK) {
+    if(net_bput(fp->nethandle, value)) error(ERR_CANTWRITE);
   } else {
 #endif
-    if (fileinfo[handle].filetype==OPENIN) {
+    if (fp->filetype==OPENIN) {
       error(ERR_OPENIN);
       return;
     }
-    fileinfo[handle].eofstatus = OKAY;
-    result = fputc(value, fileinfo[handle].stream);
-    if (result==EOF) {
-      error(ERR_CANTWRITE);
-      return;
+    fp->eofstatus = OKAY;
+    if (fp->bufpos<fp->bufsize && fp->dirtyend==fp->bufpos) {   /* Appending to the modified bytes */
+      if (fp->dirtyend==0) fp->dirtystart = fp->bufpos;
+      fp->buffer[fp->bufpos++] = value;
+      fp->dirtyend = fp->bufpos;
+      if (fp->bufpos>fp->buflen) fp->buflen = fp->bufpos;
+    } else {
+      byte ch = value;
+      write_bytes(fp, &ch, 1);
     }
-    fileinfo[handle].lastwaswrite = TRUE;
 #ifndef NONET
   }
 #endif
@@ -1116,8 +1636,6 @@ void fileio_bput(int32 handle, int32 value) {
 ** 'fileio_bputstr' writes a string to a file
 */
 void fileio_bputstr(int32 handle, char *string, int32 length) {
-  int32 result;
-
   if (handle==0) {
     error(ERR_BADHANDLE);
     return;
@@ -1133,80 +1651,124 @@ void fileio_bputstr(int32 handle, char *string, int32 length) {
       return;
     }
     fileinfo[handle].eofstatus = OKAY;
-    result = fwrite(string, sizeof(char), length, fileinfo[handle].stream);
-    if (result!=length) {
-      error(ERR_CANTWRITE);
-      return;
-    }
-    fileinfo[handle].lastwaswrite = TRUE;
+    write_bytes(&fileinfo[handle], CAST(string, byte *), length);
 #ifndef NONET
   }
 #endif
 }
 
 /*
-** 'fileio_printint' writes a four byte integer to a file in binary
-** preceded with 0x40 to mark it as an integer.
-** The number has to be written in 'big endian' format for compatibility
-** with the Acorn interpreter
+** 'fileio_getblock' reads up to 'count' bytes from file 'handle' at
+** the current file pointer into memory at 'address'. It returns the
+** number of bytes transferred, which is less than 'count' if the end
+** of the file is reached (or no more data is waiting on a network
+** connection). Large blocks are read directly into memory
 */
-void fileio_printint(int32 handle, int32 value) {
-  FILE *stream;
-  int32 n;
+int32 fileio_getblock(int32 handle, byte *address, int32 count) {
+  fileblock *fp;
+  int32 total;
 
   if (handle==0) {
     error(ERR_BADHANDLE);
-    return;
+    return 0;
   }
   handle = map_handle(handle);
-  if (fileinfo[handle].filetype==OPENIN) {
-    error(ERR_OPENIN);
-    return;
-  }
-  fileinfo[handle].eofstatus = OKAY;
-  stream = fileinfo[handle].stream;
-  fileio_write(stream, PRINT_INT);
-  for (n=24; n>=0; n-=8) fileio_write(stream, value >> n);
-  fileinfo[handle].lastwaswrite = TRUE;
+  fp = &fileinfo[handle];
+  if (count<=0) return 0;
+#ifndef NONET
+  if (fp->filetype==NETWORK) return net_read(fp->nethandle, CAST(address, char *), count);
+#endif
+  total = read_bytes(fp, address, count);
+  if (total<count) fp->eofstatus = PENDING;
+  return total;
 }
 
-void fileio_printuint8(int32 handle, uint8 value) {
-  FILE *stream;
-
+/*
+** 'fileio_putblock' writes 'count' bytes from memory at 'address' to
+** file 'handle' at the current file pointer
+*/
+void fileio_putblock(int32 handle, byte *address, int32 count) {
   if (handle==0) {
     error(ERR_BADHANDLE);
     return;
   }
   handle = map_handle(handle);
+  if (count<=0) return;
+#ifndef NONET
+  if (fileinfo[handle].filetype==NETWORK) {
+    if(net_bputstr(fileinfo[handle].nethandle, CAST(address, char *), count)) error(ERR_CANTWRITE);
+    if(net_endwrite(fileinfo[handle].nethandle)) error(ERR_CANTWRITE);
+    return;
+  }
+#endif
   if (fileinfo[handle].filetype==OPENIN) {
     error(ERR_OPENIN);
     return;
   }
   fileinfo[handle].eofstatus = OKAY;
-  stream = fileinfo[handle].stream;
-  fileio_write(stream, PRINT_UINT8);
-  fileio_write(stream, value);
-  fileinfo[handle].lastwaswrite = TRUE;
+  write_bytes(&fileinfo[handle], address, count);
 }
 
-void fileio_printint64(int32 handle, int64 value) {
-  FILE *stream;
+/*
+** 'fileio_endwrite' is called at the end of a BPUT# or PRINT# statement.
+** Everything the statement wrote to a UDP network handle is sent as
+** one datagram
+*/
+void fileio_endwrite(int32 handle) {
+#ifndef NONET
   int32 n;
+  if (handle<=0) return;
+  n = map_handle(handle);
+  if (fileinfo[n].filetype!=NETWORK) return;
+  if (net_endwrite(fileinfo[n].nethandle)) error(ERR_CANTWRITE);
+#endif
+}
 
-  if (handle==0) {
-    error(ERR_BADHANDLE);
-    return;
-  }
+/*
+** 'get_outfile' checks that file 'handle' can be written to by
+** PRINT# and returns its 'fileinfo' entry
+*/
+static fileblock *get_outfile(int32 handle) {
+  if (handle==0) error(ERR_BADHANDLE);
   handle = map_handle(handle);
-  if (fileinfo[handle].filetype==OPENIN) {
-    error(ERR_OPENIN);
-    return;
-  }
+  if (fileinfo[handle].filetype==OPENIN) error(ERR_OPENIN);
   fileinfo[handle].eofstatus = OKAY;
-  stream = fileinfo[handle].stream;
-  fileio_write(stream, PRINT_INT64);
-  for (n=56; n>=0; n-=8) fileio_write(stream, value >> n);
-  fileinfo[handle].lastwaswrite = TRUE;
+  return &fileinfo[handle];
+}
+
+/*
+** 'fileio_printint' writes a four byte integer to a file in binary
+** preceded with 0x40 to mark it as an integer.
+** The number has to be written in 'big endian' format for compatibility
+** with the Acorn interpreter
+*/
+void fileio_printint(int32 handle, int32 value) {
+  fileblock *fp = get_outfile(handle);
+  byte data[1+sizeof(int32)];
+  int32 n;
+
+  data[0] = PRINT_INT;
+  for (n=0; n<sizeof(int32); n++) data[1+n] = value >> (24-n*8);
+  write_bytes(fp, data, sizeof(data));
+}
+
+void fileio_printuint8(int32 handle, uint8 value) {
+  fileblock *fp = get_outfile(handle);
+  byte data[2];
+
+  data[0] = PRINT_UINT8;
+  data[1] = value;
+  write_bytes(fp, data, sizeof(data));
+}
+
+void fileio_printint64(int32 handle, int64 value) {
+  fileblock *fp = get_outfile(handle);
+  byte data[1+sizeof(int64)];
+  int32 n;
+
+  data[0] = PRINT_INT64;
+  for (n=0; n<sizeof(int64); n++) data[1+n] = value >> (56-n*8);
+  write_bytes(fp, data, sizeof(data));
 }
 
 /*
@@ -1218,37 +1780,27 @@ void fileio_printint64(int32 handle, int64 value) {
 ** code was written by Darren Salt
 */
 void fileio_printfloat(int32 handle, float64 value) {
-  FILE *stream;
+  fileblock *fp = get_outfile(handle);
+  byte data[1+sizeof(float64)];
   int32 n;
   char temp[sizeof(float64)];
 
-  if (handle==0) {
-    error(ERR_BADHANDLE);
-    return;
-  }
-  handle = map_handle(handle);
-  if (fileinfo[handle].filetype==OPENIN) {
-    error(ERR_OPENIN);
-    return;
-  }
-  fileinfo[handle].eofstatus = OKAY;
-  stream = fileinfo[handle].stream;
-  fileio_write(stream, PRINT_FLOAT);
+  data[0] = PRINT_FLOAT;
   memmove(temp, &value, sizeof(float64));
   switch (double_type) {
   case XMIXED_ENDIAN:
-    for (n=0; n<sizeof(float64); n++) fileio_write(stream, temp[n]);
+    for (n=0; n<sizeof(float64); n++) data[1+n] = temp[n];
     break;
   case XLITTLE_ENDIAN:
-    for (n=0; n<sizeof(float64); n++) fileio_write(stream, temp[n^4]);
+    for (n=0; n<sizeof(float64); n++) data[1+n] = temp[n^4];
     break;
   case XBIG_ENDIAN:
-    for (n=0; n<sizeof(float64); n++) fileio_write(stream, temp[n^3]);
+    for (n=0; n<sizeof(float64); n++) data[1+n] = temp[n^3];
     break;
   case XBIG_MIXED_ENDIAN:
-    for (n=0; n<sizeof(float64); n++) fileio_write(stream, temp[n^7]);
+    for (n=0; n<sizeof(float64); n++) data[1+n] = temp[n^7];
   }
-  fileinfo[handle].lastwaswrite = TRUE;
+  write_bytes(fp, data, sizeof(data));
 }
 
 /*
@@ -1261,109 +1813,118 @@ void fileio_printfloat(int32 handle, float64 value) {
 ** character order
 */
 void fileio_printstring(int32 handle, char *string, int32 length) {
-  FILE *stream;
+  fileblock *fp = get_outfile(handle);
   int32 n;
 
-  if (handle==0) {
-    error(ERR_BADHANDLE);
-    return;
-  }
-  handle = map_handle(handle);
-  if (fileinfo[handle].filetype==OPENIN) {
-    error(ERR_OPENIN);
-    return;
-  }
-  fileinfo[handle].eofstatus = OKAY;
-  stream = fileinfo[handle].stream;
   if (length<SHORT_STRING) {    /* Write string in Acorn format */
-    fileio_write(stream, PRINT_SHORTSTR);
-    fileio_write(stream, length);
-    if (length>0) for (n=length-1; n>=0; n--) fileio_write(stream, string[n]);
+    byte data[2+SHORT_STRING];
+    data[0] = PRINT_SHORTSTR;
+    data[1] = length;
+    for (n=0; n<length; n++) data[2+n] = string[length-1-n];
+    write_bytes(fp, data, 2+length);
   }
   else {        /* Long string - Use interpreter's extended format */
-    int32 result;
+    byte data[1+sizeof(int32)];
     int32 temp = length;
-    fileio_write(stream, PRINT_LONGSTR);
-    for (n=0; n<sizeof(int32); n++) {   /* Write four byte length to file */
-      fileio_write(stream, temp & BYTEMASK);
+    data[0] = PRINT_LONGSTR;
+    for (n=0; n<sizeof(int32); n++) {   /* Four byte length */
+      data[1+n] = temp & BYTEMASK;
       temp = temp>>BYTESHIFT;
     }
-    result = fwrite(string, sizeof(char), length, stream);
-    if (result!=length) {
-      error(ERR_CANTWRITE);
-      return;
-    }
+    write_bytes(fp, data, sizeof(data));
+    write_bytes(fp, CAST(string, byte *), length);
   }
-  fileinfo[handle].lastwaswrite = TRUE;
 }
 
 /*
-** 'fileio_setptr' is used to set the current file pointer
+** 'fileio_setptr' is used to set the current file pointer. If the new
+** position lies within the part of the file held in the buffer, only
+** the buffer position changes
 */
 void fileio_setptr(int32 handle, int64 newoffset) {
-  int32 result;
+  fileblock *fp;
 
   if (handle==0) {
     error(ERR_BADHANDLE);
     return;
   }
   handle = map_handle(handle);
-  result = fseek(fileinfo[handle].stream, newoffset, SEEK_SET);
-  if (result==-1) {                             /* File pointer cannot be set */
+  fp = &fileinfo[handle];
+  if (fp->filetype==NETWORK || newoffset<0) {   /* File pointer cannot be set */
     error(ERR_SETPTRFAIL);
     return;
   }
-  fileinfo[handle].eofstatus = OKAY;
+  if (newoffset>=fp->bufstart && newoffset<=fp->bufstart+fp->buflen)
+    fp->bufpos = newoffset-fp->bufstart;
+  else
+    move_window(fp, newoffset);
+  fp->eofstatus = OKAY;
 }
 
 /*
 ** 'fileio_getptr' returns the current value of the file pointer
 */
 int64 fileio_getptr(int32 handle) {
-  int64 result;
-
   if (handle==0) return 0; /* This is what happens on RISC OS 3.71 */
   handle = map_handle(handle);
-  result = ftell(fileinfo[handle].stream);
-  if (result==-1) error(ERR_GETPTRFAIL);        /* File pointer cannot be read */
-  return result;
+  if (fileinfo[handle].filetype==NETWORK) error(ERR_GETPTRFAIL);       /* Network connections do not have a file pointer */
+  return fileinfo[handle].bufstart+fileinfo[handle].bufpos;
+}
+
+/*
+** 'fileio_isnetwork' returns TRUE if 'handle' is a network handle
+*/
+boolean fileio_isnetwork(int32 handle) {
+  if (handle<=0) return FALSE;
+  handle = map_handle(handle);
+  return fileinfo[handle].filetype==NETWORK;
+}
+
+/*
+** 'file_size' returns the size of the file 'fp', including any
+** data that has yet to be written out from the buffer, or -1 if it cannot be found
+*/
+static int64 file_size(fileblock *fp) {
+  struct stat info;
+  int64 length;
+  if (fp->filetype==NETWORK || fstat(fp->fd, &info)==-1) return -1;
+  length = info.st_size;
+  if (fp->dirtyend>0 && fp->bufstart+fp->dirtyend>length) length = fp->bufstart+fp->dirtyend;
+  return length;
 }
 
 /*
 ** 'fileio_getext' returns the size of a file
 */
 int64 fileio_getext(int32 handle) {
-  int64 position, length;
-  FILE *stream;
+  int64 length;
 
   if (handle==0) {
     error(ERR_BADHANDLE);
     return 0;
   }
   handle = map_handle(handle);
-  stream = fileinfo[handle].stream;
-  position = ftell(stream);
-  if (position==-1) {
+  length = file_size(&fileinfo[handle]);
+  if (length==-1) {
     error(ERR_GETEXTFAIL);      /* Cannot find size of file */
     return 0;
   }
-  fseek(stream, 0, SEEK_END);                   /* Find the end of the file */
-  length = ftell(stream);
-  fseek(stream, position, SEEK_SET);    /* Restore file to its original file pointer position */
   return length;
 }
 
 /*
 ** 'fileio_setext' allows the size of a file to be changed.
+** Anything in the buffer is written out first and the buffer
+** emptied as its contents may no longer be part of the file
 */
 void fileio_setext(int32 handle, int64 newsize) {
-  int32 type;
+  fileblock *fp;
   
   handle=map_handle(handle);
-  type=fileinfo[handle].filetype;
-  if((type==OPENOUT) || (type==OPENUP)) {
-    int32 fh = fileno(fileinfo[handle].stream);
-    if (ftruncate(fh, newsize)) {
+  fp = &fileinfo[handle];
+  if((fp->filetype==OPENOUT) || (fp->filetype==OPENUP)) {
+    move_window(fp, fp->bufstart+fp->bufpos);
+    if (ftruncate(fp->fd, newsize)) {
       error(ERR_CMDFAIL);
     }
   } else {
@@ -1374,32 +1935,24 @@ void fileio_setext(int32 handle, int64 newsize) {
 /*
 ** 'fileio_eof' returns the current end-of-file state of file
 ** 'handle', returning 'TRUE' if it is at end-of-file.
-** The code handles two cases. It tries to emulate the RISC OS
-** way of determining end of file (the current value of the
-** file pointer is equal to the size of the file) but if this
-** fails it uses feof(). The snag with feof() is that it does
-** not return TRUE under the same conditions as the Acorn
-** definition
+** This emulates the RISC OS way of determining end of file,
+** that is, the current value of the file pointer is equal to
+** the size of the file. It cannot be at the end of the file
+** if there are still unread bytes in the buffer
 */
 int32 fileio_eof(int32 handle) {
-  long position;
-  FILE *stream;
-  boolean ateof;
+  fileblock *fp;
 
   if (handle==0) return kbd_pending();
   handle = map_handle(handle);
+  fp = &fileinfo[handle];
 #ifndef NONET
-  if (fileinfo[handle].filetype == NETWORK) {
-    return net_eof(fileinfo[handle].nethandle);
+  if (fp->filetype == NETWORK) {
+    return net_eof(fp->nethandle);
   } else {
 #endif
-  stream = fileinfo[handle].stream;
-  position = ftell(stream);
-  if (position==-1) return feof(stream) ? TRUE : FALSE;
-  fseek(stream, 0, SEEK_END);   /* Find the end of the file */
-  ateof = ftell(stream)==position;
-  fseek(stream, position, SEEK_SET);
-  return ateof;
+  if (fp->bufpos<fp->buflen) return FALSE;
+  return file_size(fp)==fp->bufstart+fp->bufpos;
 #ifndef NONET
   }
 #endif
@@ -1412,7 +1965,7 @@ int32 fileio_eof(int32 handle) {
 void fileio_shutdown(void) {
   int32 n, count;
   count = 0;
-  for (n=0; n<MAXFILES; n++) {
+  for (n=0; n<filecount; n++) {
     if (fileinfo[n].filetype!=CLOSED) {
       close_file(n);
       count++;
@@ -1425,6 +1978,21 @@ void fileio_shutdown(void) {
   }
 }
 
+#ifdef TARGET_UNIX
+/*
+** 'raise_filelimit' increases the number of files the process is allowed
+** to have open at once so that it is not less than the size the file
+** table is allowed to grow to, as far as the hard limit permits
+*/
+static void raise_filelimit(void) {
+  struct rlimit limit;
+  rlim_t wanted = maxfiles+64;  /* Allow for the interpreter's own files too */
+  if (getrlimit(RLIMIT_NOFILE, &limit)!=0 || limit.rlim_cur==RLIM_INFINITY || limit.rlim_cur>=wanted) return;
+  limit.rlim_cur = (limit.rlim_max!=RLIM_INFINITY && limit.rlim_max<wanted) ? limit.rlim_max : wanted;
+  (void) setrlimit(RLIMIT_NOFILE, &limit);
+}
+#endif
+
 /*
 ** 'find_floatformat' is called to work out what format the machine
 ** on which the interpreter is running stores eight byte floating point
@@ -1458,12 +2026,13 @@ static void find_floatformat(void) {
 ** 'init_fileio' is called to initialise the file handling
 */
 void init_fileio(void) {
-  int32 n;
-  for (n=0; n<MAXFILES; n++) {
-    fileinfo[n].stream = NIL;
-    fileinfo[n].filetype = CLOSED;
-    fileinfo[n].eofstatus = ATEOF;
-  }
+  fileinfo = NIL;       /* The table is created when the first file is opened */
+  filecount = 0;
+  firstfree = -1;
+  maxfiles = matrixflags.maxfiles>0 ? matrixflags.maxfiles : MAXFILES;
+#ifdef TARGET_UNIX
+  raise_filelimit();
+#endif
   find_floatformat();
 }
 
@@ -43,8 +43,18 @@ extern void fileio_printuint8(int32, uint8);
 extern void fileio_printint64(int32, int64);
 extern void fileio_printfloat(int32, float64);
 extern void fileio_printstring(int32, char *, int32);
+extern void fileio_endwrite(int32);
+extern int32 fileio_getblock(int32, byte *, int32);
+extern void fileio_putblock(int32, byte *, int32);
+extern int32 fileio_netaccept(int32);
+extern int32 fileio_netconnect(char *);
+extern int32 fileio_netstatus(int32);
+extern void fileio_netflush(int32);
+extern int32 fileio_netoptions(int32, int32);
+extern void fileio_netshutdown(int32);
 extern int32 fileio_eof(int32);
 extern int64 fileio_getptr(int32);
+extern boolean fileio_isnetwork(int32);
 extern void fileio_setptr(int32, int64);
 extern int64 fileio_getext(int32);
 extern void fileio_setext(int32, int64);
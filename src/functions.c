@@ -1010,7 +1010,15 @@ static void fn_getdol(void) {
   } else if (*basicvars.current == '#') {       /* Have encountered the 'GET$#' version */
     basicvars.current++;
     handle = eval_intfactor();
-    count = fileio_getdol(handle, basicvars.stringwork);
+    if (*basicvars.current == BASTOKEN_BY) {    /* 'GET$#<handle> BY <count>' - Read up to <count> bytes */
+      basicvars.current++;
+      count = eval_intfactor();
+      if (count > MAXSTRING) count = MAXSTRING;
+      count = fileio_getblock(handle, CAST(basicvars.stringwork, byte *), count);
+    }
+    else {
+      count = fileio_getdol(handle, basicvars.stringwork);
+    }
     cp = alloc_string(count);
     memcpy(cp, basicvars.stringwork, count);
     push_strtemp(count, cp);
@@ -36,6 +36,7 @@
 #include <SDL.h>
 #include <sys/time.h>
 #include <math.h>
+#include <pthread.h>
 #include "common.h"
 #include "target.h"
 #if defined(TARGET_UNIX) && defined(USE_X11)
@@ -156,6 +157,7 @@ mousequeue *mousebuffer = NULL;
 uint32 mousequeuelength = 0;
 uint32 mouseqexpire = 0;
 #define MOUSEQUEUEMAX 7
+#define FRAMERATE_MAX 1000      /* Highest rate Brandy_FrameRate accepts */
 
 #ifndef BRANDY_MODE7ONLY
 static int32 geom_left[MAX_YRES], geom_right[MAX_YRES];
@@ -177,6 +179,7 @@ Uint8 mode7cloneframe[26][40];
 static int64 mode7timer = 0;            /* Timer for bank switching */
 static Uint8 vdu141track[27];           /* Track use of Double Height in Mode 7 *
                                          * First line is [1] */
+static Uint8 mode7flashrow[26];         /* Rows of the Mode 7 screen with flashing characters */
 threadmsg tmsg;
 
 int32 titlestringLen = 256;
@@ -232,6 +235,12 @@ static struct {
   boolean clipping;                     /* TRUE if clipping region is not full screen of a RISC OS mode */
 } ds;
 
+static struct {
+  int32 rate;                           /* Target frames per second. 0 = frames are not paced */
+  int32 refresh;                        /* *Refresh state to go back to when pacing stops */
+  int64 due;                            /* Time the next frame is due, in microseconds */
+} framepace;
+
 /*
 ** function definitions
 */
@@ -247,8 +256,10 @@ static void scroll_yneg(int32 windowed);
 //static void cursor_move_sp(int32 *curx, int32 *cury, int32 incx, int32 incy);
 //static void cursor_move(int32 *curx, int32 *cury, int32 incx, int32 incy);
 static void reveal_cursor(void);
+static void dump_frame(void);
 #ifndef BRANDY_MODE7ONLY
 static void plot_pixel(SDL_Surface *, int32, int32, Uint32, Uint32);
+static void plot_span(SDL_Surface *, int32, int32, int32, Uint32, Uint32);
 static void draw_line(SDL_Surface *, int32, int32, int32, int32, Uint32, int32, Uint32);
 static void filled_triangle(SDL_Surface *, int32, int32, int32, int32, int32, int32, Uint32, Uint32);
 static void draw_ellipse(SDL_Surface *, int32, int32, int32, int32, int32, Uint32, Uint32, Uint32);
@@ -817,6 +828,97 @@ static void reveal_cursor() {
   if (cursorstate==SUSPENDED) toggle_cursor();
 }
 
+/*
+** Changes to the display surface are recorded as a list of damaged
+** rectangles, in display surface pixels. The video update thread copies
+** only these areas to the window, once per frame, and does nothing if the
+** screen has not changed. Rectangles that touch or overlap are merged
+** and if the list fills up everything is merged into one rectangle
+*/
+#define MAXDAMAGE 16
+
+static struct {
+  int32 left, top, right, bottom;
+} damage[MAXDAMAGE];
+static int32 damagecount;
+static pthread_mutex_t damagelock = PTHREAD_MUTEX_INITIALIZER;  /* Protects 'damage' and 'damagecount' */
+
+/*
+** 'add_damage' records that the area of the display surface from
+** (left, top) to (right, bottom) inclusive has changed
+*/
+static void add_damage(int32 left, int32 top, int32 right, int32 bottom) {
+  int32 n;
+
+  if (left < 0) left = 0;
+  if (top < 0) top = 0;
+  if (right >= matrixflags.surface->w) right = matrixflags.surface->w-1;
+  if (bottom >= matrixflags.surface->h) bottom = matrixflags.surface->h-1;
+  if (left > right || top > bottom) return;
+  pthread_mutex_lock(&damagelock);
+  for (n = 0; n < damagecount; n++) {
+    if (left <= damage[n].right+1 && right >= damage[n].left-1 && top <= damage[n].bottom+1 && bottom >= damage[n].top-1) break;
+  }
+  if (n == damagecount) {
+    if (damagecount < MAXDAMAGE) {
+      damagecount++;
+      damage[n].left = left;
+      damage[n].top = top;
+      damage[n].right = right;
+      damage[n].bottom = bottom;
+      pthread_mutex_unlock(&damagelock);
+      return;
+    }
+/* No room left. Merge everything into the first entry */
+    for (n = 1; n < damagecount; n++) {
+      if (damage[n].left < damage[0].left) damage[0].left = damage[n].left;
+      if (damage[n].top < damage[0].top) damage[0].top = damage[n].top;
+      if (damage[n].right > damage[0].right) damage[0].right = damage[n].right;
+      if (damage[n].bottom > damage[0].bottom) damage[0].bottom = damage[n].bottom;
+    }
+    damagecount = 1;
+    n = 0;
+  }
+  if (left < damage[n].left) damage[n].left = left;
+  if (top < damage[n].top) damage[n].top = top;
+  if (right > damage[n].right) damage[n].right = right;
+  if (bottom > damage[n].bottom) damage[n].bottom = bottom;
+  pthread_mutex_unlock(&damagelock);
+}
+
+/*
+** 'damage_all' records that the whole of the display surface has changed
+*/
+static void damage_all(void) {
+  add_damage(0, 0, matrixflags.surface->w-1, matrixflags.surface->h-1);
+}
+
+/*
+** 'update_display' copies the damaged areas of the display surface to
+** the window and clears the list. If the display surface is double
+** buffered the whole surface has to be flipped instead
+*/
+static void update_display(void) {
+  SDL_Rect rects[MAXDAMAGE];
+  int32 n, count;
+
+  pthread_mutex_lock(&damagelock);
+  count = damagecount;
+  for (n = 0; n < count; n++) {
+    rects[n].x = damage[n].left;
+    rects[n].y = damage[n].top;
+    rects[n].w = damage[n].right - damage[n].left + 1;
+    rects[n].h = damage[n].bottom - damage[n].top + 1;
+  }
+  damagecount = 0;
+  pthread_mutex_unlock(&damagelock);
+  if (count == 0) return;
+  if (matrixflags.surface->flags & SDL_DOUBLEBUF)
+    SDL_Flip(matrixflags.surface);
+  else
+    SDL_UpdateRects(matrixflags.surface, count, rects);
+}
+
 /*
 ** 'toggle_cursor' draws the text cursor at the current text position
 ** in graphics modes.
@@ -839,6 +941,8 @@ static void toggle_cursor(void) {
         (matrixflags.cursorbusy)                                    /* Have we flagged the cursor as being busy? */
   ||
         (cursorstate == HIDDEN)
+  ||
+        (basicvars.runflags.headless)                               /* There is no window to show it in */
   ) return;
 
   if ((tmsg.crtc6845r10 & 96) == 32) {                              /* After VDU 23;8202;0;0;0; */
@@ -874,6 +978,7 @@ static void toggle_cursor(void) {
     }
     startpt--;
   }
+  add_damage(left*matrixflags.videoscale, ytext*ysc*matrixflags.videoscale*myppc, (right+1)*matrixflags.videoscale-1, (ytext+1)*ysc*matrixflags.videoscale*myppc-1);
 }
 
 /*
@@ -895,28 +1000,47 @@ static void toggle_cursor(void) {
 ** and 'yscale'.
 */
 
-/* blit_scaled_actual2 is also used directly for MODE 7 rendering when scaled */
+/*
+** blit_scaled_actual2 is also used directly for MODE 7 rendering when scaled.
+** Each row of the rectangle is enlarged once into the screen buffer, with
+** separate loops for the common horizontal scale factors, and the result
+** is then copied to the other rows it has to fill
+*/
 static void blit_scaled_actual2(int32 left, int32 top, int32 right, int32 bottom, SDL_Surface* srcsurface) {
-  int32 xx, yy;
+  int32 yy;
   int32 xscale = ds.xscale * matrixflags.videoscale;
   int32 yscale = ds.yscale * matrixflags.videoscale;
   int32 dleft = left*xscale;                               /* Calculate pixel coordinates in the */
   int32 dtop  = top*yscale;                                /* screen buffer of the rectangle */
-  int32 i, j, ii, jj;
+  int32 dwidth = ds.vscrwidth*matrixflags.videoscale;      /* Width of a row of the screen buffer */
+  size_t rowsize = (size_t)(right-left+1)*xscale*sizeof(Uint32);
+  int32 i, j, ii, jj, count = right-left+1;
   yy = dtop;
   for (j = top; j <= bottom; j++) {
-    for (jj = 1; jj <= yscale; jj++) {
-      xx = dleft;
-      for (i = left; i <= right; i++) {
-        for (ii = 1; ii <= xscale; ii++) {
-          *((Uint32*)matrixflags.surface->pixels + xx + yy*ds.vscrwidth*matrixflags.videoscale) = 
-            *((Uint32*)srcsurface->pixels + i + j*ds.vscrwidth);
-          xx++;
+    Uint32 *src = (Uint32*)srcsurface->pixels + left + (int64)j*ds.vscrwidth;
+    Uint32 *dest = (Uint32*)matrixflags.surface->pixels + dleft + (int64)yy*dwidth;
+    switch (xscale) {
+      case 1:
+        memcpy(dest, src, rowsize);
+        break;
+      case 2:
+        for (i = 0; i < count; i++) dest[2*i] = dest[2*i+1] = src[i];
+        break;
+      case 3:
+        for (i = 0; i < count; i++) dest[3*i] = dest[3*i+1] = dest[3*i+2] = src[i];
+        break;
+      case 4:
+        for (i = 0; i < count; i++) dest[4*i] = dest[4*i+1] = dest[4*i+2] = dest[4*i+3] = src[i];
+        break;
+      default:
+        for (i = 0; i < count; i++) {
+          for (ii = 0; ii < xscale; ii++) dest[i*xscale+ii] = src[i];
         }
-      }
-      yy++;
-    } 
+    }
+    for (jj = 1; jj < yscale; jj++) memcpy(dest + (int64)jj*dwidth, dest, rowsize);
+    yy += yscale;
   }
+  add_damage(dleft, dtop, (right+1)*xscale-1, (bottom+1)*yscale-1);
   if ((screenmode == 3) || (screenmode == 6)) {       /* Paint on the black bars over the background */
     int p;
     hide_cursor();
@@ -924,12 +1048,13 @@ static void blit_scaled_actual2(int32 left, int32 top, int32 right, int32 bottom
       yy=(16+(p*20))*matrixflags.videoscale;
       memset(matrixflags.surface->pixels + 4*yy*ds.vscrwidth*matrixflags.videoscale, 0, 16*ds.screenwidth*xscale*matrixflags.videoscale);
     }
+    damage_all();
   }
 }
 
 #ifndef BRANDY_MODE7ONLY
 static void blit_scaled_actual(int32 left, int32 top, int32 right, int32 bottom) {
-  int32 xx, yy;
+  int32 yy;
 /*
 ** Start by clipping the rectangle to be blit'ed if it extends off the
 ** screen.
@@ -945,19 +1070,16 @@ static void blit_scaled_actual(int32 left, int32 top, int32 right, int32 bottom)
   if ((!ds.scaled) && (matrixflags.videoscale == 1)) {
     if ((top == 0) && (left == 0) && (right == ds.screenwidth-1) && (bottom == ds.screenheight-1)) {
       /* Special high-speed memory copy for full-screen non-scaled blits */
-      uint64 *dptr, *sptr, lptr, scrsz;
-      sptr = screenbank[ds.displaybank]->pixels;
-      dptr = matrixflags.surface->pixels;
-      scrsz = (ds.screenwidth*ds.screenheight)/2;
-      for (lptr = 0; lptr < scrsz; lptr++) *(dptr++) = *(sptr++);
+      memcpy(matrixflags.surface->pixels, screenbank[ds.displaybank]->pixels, (size_t)ds.screenwidth*ds.screenheight*sizeof(Uint32));
     } else {
-      for (xx=left; xx <= right; xx++) {
-        for (yy=top; yy <= bottom; yy++) {
-          int32 pxoffset = xx + yy*ds.vscrwidth;
-          *((Uint32*)matrixflags.surface->pixels + pxoffset) = *((Uint32*)screenbank[ds.displaybank]->pixels + pxoffset);
-        }
+      /* Otherwise copy the rectangle a row at a time */
+      size_t rowsize = (size_t)(right-left+1)*sizeof(Uint32);
+      for (yy=top; yy <= bottom; yy++) {
+        int64 pxoffset = left + (int64)yy*ds.vscrwidth;
+        memcpy((Uint32*)matrixflags.surface->pixels + pxoffset, (Uint32*)screenbank[ds.displaybank]->pixels + pxoffset, rowsize);
       }
     }
+    add_damage(left, top, right, bottom);
   } else {
     blit_scaled_actual2(left, top, right, bottom, screenbank[ds.displaybank]);
   }
@@ -965,10 +1087,62 @@ static void blit_scaled_actual(int32 left, int32 top, int32 right, int32 bottom)
 
 static void blit_scaled(int32 left, int32 top, int32 right, int32 bottom) {
   if ((ds.autorefresh != 1) || (ds.displaybank != ds.writebank)) return;
+  if (basicvars.runflags.headless) return;      /* The screen is only copied when it is saved */
   blit_scaled_actual(left, top, right, bottom);
 }
 #endif
 
+/*
+** Characters written to the screen are not copied to the display surface
+** one at a time. The area they cover is collected in 'textblit' and copied
+** in one go by flush_text() once emulate_vdu() or emulate_vdustr() has
+** finished, or before anything that needs the display surface to be up
+** to date, such as scrolling it or waiting for a key press
+*/
+static struct {
+  boolean pending;                      /* TRUE if there is an area to copy */
+  int32 left, top, right, bottom;       /* Area to copy, in screen buffer pixels */
+} textblit;
+
+#ifndef BRANDY_MODE7ONLY
+/*
+** 'defer_blit' adds the rectangle (left, top) to (right, bottom) to the
+** area to be copied to the display surface by flush_text()
+*/
+static void defer_blit(int32 left, int32 top, int32 right, int32 bottom) {
+  if (!textblit.pending) {
+    textblit.left = left;
+    textblit.top = top;
+    textblit.right = right;
+    textblit.bottom = bottom;
+    textblit.pending = TRUE;
+    return;
+  }
+  if (left < textblit.left) textblit.left = left;
+  if (top < textblit.top) textblit.top = top;
+  if (right > textblit.right) textblit.right = right;
+  if (bottom > textblit.bottom) textblit.bottom = bottom;
+}
+#endif
+
+/*
+** 'flush_text' copies the area collected by defer_blit() to the display
+** surface. The cursor is only drawn on the display surface, so it is
+** removed while the copy is made
+*/
+static void flush_text(void) {
+#ifndef BRANDY_MODE7ONLY
+  boolean shown;
+
+  if (!textblit.pending) return;
+  textblit.pending = FALSE;
+  shown = (cursorstate == ONSCREEN);
+  if (shown) toggle_cursor();
+  blit_scaled(textblit.left, textblit.top, textblit.right, textblit.bottom);
+  if (shown) toggle_cursor();
+#endif
+}
+
 #define COLOURSTEP 68           /* RGB colour value increment used in 256 colour modes */
 #define TINTSTEP 17             /* RGB colour value increment used for tints */
 
@@ -1207,6 +1381,8 @@ static void scroll_up(int32 windowed) {
   } else {
     int loop;
     int top = 4*ds.screenwidth*YPPC*ds.xscale;            /* First, get size of one line. */
+
+    flush_text();         /* Bring the display surface up to date before scrolling it */
     /* Screen size minus size of one line (calculated above) */
     dest=(ds.screenwidth * ds.screenheight * 4 * ds.xscale) - top;
     memmove((byte *)screenbank[ds.writebank]->pixels, (const byte *)(screenbank[ds.writebank]->pixels)+top, dest);
@@ -1219,6 +1395,7 @@ static void scroll_up(int32 windowed) {
     for (loop=0;loop<(top*ds.yscale);loop+=4) {
       *(uint32 *)(matrixflags.surface->pixels+(dest*ds.yscale)+loop) = SWAPENDIAN(ds.tb_colour);
     }
+    damage_all();
   }
   toggle_cursor();
 #endif
@@ -1281,6 +1458,7 @@ static void scroll_down(int32 windowed) {
 
   } else {
     int loop;
+    flush_text();         /* Bring the display surface up to date before scrolling it */
     /* First, get size of one line. */
     top=4*ds.screenwidth*YPPC*ds.xscale;
     /* Screen size minus size of one line (calculated above) */
@@ -1294,6 +1472,7 @@ static void scroll_down(int32 windowed) {
     for (loop=0;loop<(top*ds.yscale);loop+=4) {
       *(uint32 *)(matrixflags.surface->pixels+loop) = SWAPENDIAN(ds.tb_colour);
     }
+    damage_all();
   }
   toggle_cursor();
 #endif
@@ -1491,6 +1670,68 @@ static void scroll_yneg(int32 windowed) {
   }
 }
 
+#ifndef BRANDY_MODE7ONLY
+/*
+** Text is drawn using tables of the pixels for every possible row of a
+** character in a given pair of text foreground and background colours, so
+** each row of a character is copied to the screen in one go. A few tables
+** are kept as programs often switch between two or three sets of colours
+*/
+#define GLYPHSETS 4
+
+static struct {
+  boolean valid;
+  Uint32 fore, back;            /* Colours the table was built for */
+  Uint32 rows[256*XPPC];        /* Pixels for each of the 256 possible rows */
+} glyphsets[GLYPHSETS];
+static int32 glyphlast, glyphnext;      /* Table used last and next table to replace */
+
+/*
+** 'glyph_rows' returns the table of character rows for the current text
+** colours, building it if necessary
+*/
+static Uint32 *glyph_rows(void) {
+  int32 n, line, r;
+
+  if (glyphsets[glyphlast].valid && glyphsets[glyphlast].fore == ds.tf_colour && glyphsets[glyphlast].back == ds.tb_colour) return glyphsets[glyphlast].rows;
+  for (n = 0; n < GLYPHSETS; n++) {
+    if (glyphsets[n].valid && glyphsets[n].fore == ds.tf_colour && glyphsets[n].back == ds.tb_colour) {
+      glyphlast = n;
+      return glyphsets[n].rows;
+    }
+  }
+  n = glyphnext;
+  glyphnext = (glyphnext+1) % GLYPHSETS;
+  for (line = 0; line < 256; line++) {
+    for (r = 0; r < XPPC; r++) glyphsets[n].rows[line*XPPC+r] = (line & 1<<(7-r)) ? ds.tf_colour : ds.tb_colour;
+  }
+  glyphsets[n].fore = ds.tf_colour;
+  glyphsets[n].back = ds.tb_colour;
+  glyphsets[n].valid = TRUE;
+  glyphlast = n;
+  return glyphsets[n].rows;
+}
+#endif /* BRANDY_MODE7ONLY */
+
+#ifndef BRANDY_MODE7ONLY
+/*
+** 'draw_char' draws character 'ch' at the text cursor position using
+** the text colours
+*/
+static void draw_char(int32 ch) {
+  int32 y, topx, topy;
+  Uint32 *glyphs;
+
+  topx = xtext*XPPC;
+  topy = ytext*YPPC;
+  glyphs = glyph_rows();
+  for (y=0; y < 8; y++) {
+    memcpy((Uint32*)screenbank[ds.writebank]->pixels + topx + ((topy+y)*ds.vscrwidth), glyphs + sysfont[ch-' '][y]*XPPC, XPPC*sizeof(Uint32));
+  }
+  defer_blit(topx, topy, topx+XPPC-1, topy+YPPC-1);
+}
+#endif /* BRANDY_MODE7ONLY */
+
 /*
 ** 'write_char' draws a character when in fullscreen graphics mode
 ** when output is going to the text cursor. It assumes that the
@@ -1501,8 +1742,7 @@ static void scroll_yneg(int32 windowed) {
 */
 #ifndef BRANDY_MODE7ONLY
 static void write_char(int32 ch) {
-  int32 y, topx, topy, r;
-  
+
   if (cursorstate == ONSCREEN) toggle_cursor();
   matrixflags.cursorbusy = 1;
   if (SCROLLPROT && ((xtext > twinright) || (xtext < twinleft))) {  /* Scroll before character if scroll protect enabled */
@@ -1512,6 +1752,7 @@ static void write_char(int32 ch) {
     if (vduflag(VDU_FLAG_ENAPAGE)) {
       matrixflags.vdu14lines++;
       if (matrixflags.vdu14lines > (twinbottom-twintop)) {
+        flush_text();
         while (kbd_modkeys(1)==0 && kbd_escpoll()==0) usleep(5000);
         matrixflags.vdu14lines=0;
       }
@@ -1533,14 +1774,7 @@ static void write_char(int32 ch) {
       }
     }
   }
-  topx = xtext*XPPC;
-  topy = ytext*YPPC;
-  for (y=0; y < 8; y++) {
-    int32 line = sysfont[ch-' '][y];
-    for (r=0; r < 8; r++)
-      *((Uint32*)screenbank[ds.writebank]->pixels + topx + r + ((topy+y)*ds.vscrwidth)) = (line & 1<<(7-r)) ? ds.tf_colour : ds.tb_colour;
-  }
-  blit_scaled(topx, topy, topx+XPPC-1, topy+YPPC-1);
+  draw_char(ch);
   xtext+=textxinc();
   if (!SCROLLPROT && ((xtext > twinright) || (xtext < twinleft))) {  /* Scroll before character if scroll protect enabled */
     xtext = textxhome();
@@ -1549,6 +1783,7 @@ static void write_char(int32 ch) {
     if (vduflag(VDU_FLAG_ENAPAGE)) {
       matrixflags.vdu14lines++;
       if (matrixflags.vdu14lines > (twinbottom-twintop)) {
+        flush_text();
         while (kbd_modkeys(1)==0 && kbd_escpoll()==0) usleep(5000);
         matrixflags.vdu14lines=0;
       }
@@ -1573,6 +1808,43 @@ static void write_char(int32 ch) {
   matrixflags.cursorbusy = 0;
 }
 
+/*
+** 'write_run' writes the 'count' printable characters at 'text' at the
+** text cursor. The cursor is removed once for the whole run, and the
+** characters that do not reach the edge of the text window are drawn
+** without any of the checks for wrapping or scrolling. The character
+** that does reach the edge goes through write_char() to deal with that
+*/
+static void write_run(char *text, int32 count) {
+  int32 n, fit;
+
+  hide_cursor();
+  while (count > 0) {
+    if (xtext < twinleft || xtext > twinright) {
+      fit = 0;
+    } else if (textxinc() > 0) {
+      fit = twinright-xtext;
+    } else {
+      fit = xtext-twinleft;
+    }
+    if (fit > count) fit = count;
+    matrixflags.cursorbusy = 1;
+    for (n = 0; n < fit; n++) {
+      draw_char(text[n] & BYTEMASK);
+      xtext+=textxinc();
+    }
+    matrixflags.cursorbusy = 0;
+    text += fit;
+    count -= fit;
+    if (count > 0) {
+      write_char(*text & BYTEMASK);
+      text++;
+      count--;
+    }
+  }
+  reveal_cursor();
+}
+
 static void vdu5_cursorup(void) {
   switch (MOVFLAG) {
     case 0: case 1:
@@ -1630,12 +1902,15 @@ static void plot_char(int32 ch) {
     int32 line;
     if ((topy+y) >= modetable[screenmode].yres) break;
     line = sysfont[ch-' '][y];
-    if (line!=0) {
-      for (r=0;r<8;r++)
-        if (line & 1<<(7-r)) plot_pixel(screenbank[ds.writebank], (topx + r), (topy+y), ds.gf_colour, ds.graph_fore_action);
+    for (r=0; r < 8; r++) {     /* Plot each run of set bits in the row as one span */
+      if (line & 1<<(7-r)) {
+        int32 start = r;
+        while (r < 7 && (line & 1<<(6-r))) r++;
+        plot_span(screenbank[ds.writebank], topy+y, topx+start, topx+r, ds.gf_colour, ds.graph_fore_action);
+      }
     }
   }
-  blit_scaled(topx, topy, topx+XPPC-1, topy+YPPC-1);
+  defer_blit(topx, topy, topx+XPPC-1, topy+YPPC-1);
 
   cursorstate = SUSPENDED; /* because we just overwrote it */
   if (!(vdu2316byte & 8)) ds.xlast += XPPC*ds.xgupp * textxinc();       /* Move to next character position in X direction */
@@ -1895,6 +2170,7 @@ static void move_curdown(void) {
     if (vduflag(VDU_FLAG_ENAPAGE)) {
       matrixflags.vdu14lines++;
       if (matrixflags.vdu14lines > (twinbottom-twintop)) {
+        flush_text();
         while (kbd_modkeys(1)==0 && kbd_escpoll()==0) usleep(5000);
         matrixflags.vdu14lines=0;
       }
@@ -1922,6 +2198,7 @@ static void move_curup(void) {
       matrixflags.vdu14lines++;
 // BUG: paged mode should not stop scrolling upwards
       if (matrixflags.vdu14lines > (twinbottom-twintop)) {
+        flush_text();
         while (kbd_modkeys(1)==0 && kbd_escpoll()==0) usleep(5000);
         matrixflags.vdu14lines=0;
       }
@@ -2013,15 +2290,11 @@ static void vdu_return(void) {
 
 #ifndef BRANDY_MODE7ONLY
 static void fill_rectangle(int32 left, int32 top, int32 right, int32 bottom, Uint32 colour, int32 action) {
-  int32 xloop, yloop;
+  int32 yloop;
 
   if (action == 5) return;
 
-  for (yloop=top;yloop<=bottom; yloop++) {
-    for (xloop=left; xloop<=right; xloop++) {
-      plot_pixel(screenbank[ds.writebank], xloop, yloop, colour, action);
-    }
-  }
+  for (yloop=top;yloop<=bottom; yloop++) plot_span(screenbank[ds.writebank], yloop, left, right, colour, action);
 
 }
 
@@ -2341,13 +2614,13 @@ static void printer_char(void) {
 }
 
 /*
-** 'emulate_vdu' is a simple emulation of the RISC OS VDU driver. It
+** 'vdu_char' is a simple emulation of the RISC OS VDU driver. It
 ** accepts characters as per the RISC OS driver and uses them to imitate
 ** some of the VDU commands. Some of them are not supported and flagged
 ** as errors but others, for example, the 'page mode on' and 'page mode
 ** off' commands, are silently ignored.
 */
-void emulate_vdu(int32 charvalue) {
+static void vdu_char(int32 charvalue) {
   charvalue = charvalue & BYTEMASK;     /* Deal with any signed char type problems */
   if (matrixflags.dospool) fputc(charvalue, matrixflags.dospool);
   if (matrixflags.printer) printout_character(charvalue);
@@ -2368,6 +2641,7 @@ void emulate_vdu(int32 charvalue) {
           if (vduflag(VDU_FLAG_ENAPAGE)) {
             matrixflags.vdu14lines++;
             if (matrixflags.vdu14lines > (twinbottom-twintop)) {
+              flush_text();
               while (kbd_modkeys(1)==0 && kbd_escpoll()==0) usleep(5000);
               matrixflags.vdu14lines=0;
             }
@@ -2410,6 +2684,7 @@ void emulate_vdu(int32 charvalue) {
           if (vduflag(VDU_FLAG_ENAPAGE)) {
             matrixflags.vdu14lines++;
             if (matrixflags.vdu14lines > (twinbottom-twintop)) {
+              flush_text();
               while (kbd_modkeys(1)==0 && kbd_escpoll()==0) usleep(5000);
               matrixflags.vdu14lines=0;
             }
@@ -2581,21 +2856,49 @@ void emulate_vdu(int32 charvalue) {
 }
 
 /*
-** 'emulate_vdustr' is called to print a string via the 'VDU driver'
+** 'emulate_vdu' sends a character to the VDU driver
+*/
+void emulate_vdu(int32 charvalue) {
+  vdu_char(charvalue);
+  flush_text();
+}
+
+/*
+** 'emulate_vdustr' is called to print a string via the 'VDU driver'.
+** The text is copied to the display surface once the whole string
+** has been written
 */
 void emulate_vdustr(char string[], int32 length) {
   int32 n;
   if (length == 0) length = strlen(string);
   for (n = 0; n < length; n++) {
-    emulate_vdu(string[n]);        /* Send the string to the VDU driver */
+#ifndef BRANDY_MODE7ONLY
+    if (vduneeded == 0 && basicvars.printwidth == 0 && screenmode != 7 && !vduflag(VDU_FLAG_DISABLE) && !vduflag(VDU_FLAG_GRAPHICURS)) {
+      /* Find the run of printable characters starting here and write it in one go */
+      int32 run;
+      for (run = n; run < length && (string[run] & BYTEMASK) >= ' ' && (string[run] & BYTEMASK) != DEL; run++);
+      if (run > n) {
+        if (matrixflags.dospool) fwrite(string+n, 1, run-n, matrixflags.dospool);
+        if (matrixflags.printer) {
+          int32 p;
+          for (p = n; p < run; p++) printout_character(string[p] & BYTEMASK);
+        }
+        write_run(string+n, run-n);
+        n = run-1;
+        continue;
+      }
+    }
+#endif
+    vdu_char(string[n]);        /* Send the string to the VDU driver */
     if (basicvars.printwidth > 0) {
       if ((emulate_pos() - basicvars.xtab) == basicvars.printwidth) {
-        emulate_vdu(asc_CR);
-        emulate_vdu(asc_LF);
+        vdu_char(asc_CR);
+        vdu_char(asc_LF);
         basicvars.xtab = 0;
       }
     }
   }
+  flush_text();
 }
 
 /*
@@ -2710,7 +3013,7 @@ static void setup_mode(int32 mode) {
     }
   }
   memset(matrixflags.surface->pixels, 0, 4 * sx * sy * matrixflags.videoscale * matrixflags.videoscale);
-  ds.autorefresh=1;
+  ds.autorefresh = (framepace.rate > 0) ? 2 : 1;        /* Paced frames are only shown by Brandy_FramePresent */
   ds.vscrwidth = sx;
   ds.vscrheight = sy;
   for (p=0; p<MAXBANKS; p++) {
@@ -2790,6 +3093,7 @@ static void setup_mode(int32 mode) {
     font_rect.h = place_rect.h = YPPC;
     tmsg.crtc6845r10 = 103;
   }
+  damage_all();
   tmsg.modechange = -1;
 }
 
@@ -2810,6 +3114,8 @@ void emulate_mode(int32 mode) {
   }
 /* Reset colours, clear screen and home cursor */
   SDL_FillRect(matrixflags.surface, NULL, ds.tb_colour);
+  damage_all();
+  textblit.pending = FALSE;     /* Any text waiting to be copied was in the old mode */
   for (p=0; p<MAXBANKS; p++) {
     SDL_FillRect(screenbank[p], NULL, ds.tb_colour);
   }
@@ -2892,11 +3198,53 @@ int32 emulate_modefn(void) {
   return screenmode;
 }
 
+#ifndef BRANDY_MODE7ONLY
+/*
+** 'gcol_pixel' returns the pixel value that results from applying GCOL
+** action 'action' with colour number 'drawcolour' to a pixel that holds
+** 'pixel'. Both pixel values are as they are stored in the screen buffer
+*/
+static Uint32 gcol_pixel(Uint32 pixel, Uint32 drawcolour, Uint32 action) {
+  Uint32 prevcolour, altcolour, a;
+
+  prevcolour=SWAPENDIAN(pixel);
+  prevcolour=emulate_colourfn((prevcolour >> 16) & 0xFF, (prevcolour >> 8) & 0xFF, (prevcolour & 0xFF));
+  switch (action) {
+    case 1:
+      altcolour=(prevcolour | drawcolour);
+      break;
+    case 2:
+      altcolour=(prevcolour & drawcolour);
+      break;
+    case 3:
+      altcolour=(prevcolour ^ drawcolour);
+      break;
+    case 4:
+      altcolour=(prevcolour ^ (colourdepth-1));
+      break;
+    case 6:
+      altcolour=(prevcolour & ((~drawcolour) & (colourdepth-1)));
+      break;
+    case 7:
+      altcolour=(prevcolour | ((~drawcolour) & (colourdepth-1)));
+      break;
+    default:
+      altcolour=drawcolour; /* Invalid GCOL action code handled as 0 */
+  }
+  if (colourdepth == COL24BIT) {
+    altcolour = altcolour & 0xFFFFFF;
+  } else {
+    a=altcolour;
+    altcolour=altcolour*3;
+    altcolour=SDL_MapRGB(sdl_fontbuf->format, palette[altcolour+0], palette[altcolour+1], palette[altcolour+2]) + (a << 24);
+  }
+  return SWAPENDIAN(altcolour);
+}
+
 /* The plot_pixel function plots pixels for the drawing functions, and
    takes into account the GCOL foreground action code */
-#ifndef BRANDY_MODE7ONLY
 static void plot_pixel(SDL_Surface *surface, int32 x, int32 y, Uint32 colour, Uint32 action) {
-  Uint32 altcolour = 0, prevcolour, drawcolour, a;
+  Uint32 drawcolour;
   int32 rox = 0, roy = 0;
   int64 offset = x + (y*ds.vscrwidth);
 
@@ -2920,100 +3268,217 @@ static void plot_pixel(SDL_Surface *surface, int32 x, int32 y, Uint32 colour, Ui
     }
 #endif
   }
+  if ((action==0) && (ds.plot_inverse == 0)) {
+    *((Uint32*)surface->pixels + offset) = SWAPENDIAN(colour);
+    return;
+  }
   if (ds.plot_inverse ==1) {
     action=3;
     drawcolour=(colourdepth-1);
   } else {
     drawcolour=ds.graph_physforecol;
   }
+  *((Uint32*)surface->pixels + offset) = gcol_pixel(*((Uint32*)surface->pixels + offset), drawcolour, action);
+}
 
-  if ((action==0) && (ds.plot_inverse == 0)) {
-    altcolour = colour;
+/*
+** 'window_pixels' finds the extent of the graphics window in pixels,
+** trimmed to the pixels that plot_pixel() would plot and to the screen.
+** It returns FALSE if none of the window is on the screen
+*/
+static boolean window_pixels(int32 *left, int32 *top, int32 *right, int32 *bottom) {
+  int32 pwinleft, pwinright, pwintop, pwinbottom;
+
+  if (!ds.clipping) {
+    *left = *top = 0;
+    *right = ds.screenwidth-1;
+    *bottom = ds.screenheight-1;
+    return TRUE;
+  }
+  pwinleft = GXTOPX(ds.gwinleft);
+  pwinright = GXTOPX(ds.gwinright);
+  pwintop = GYTOPY(ds.gwintop);
+  pwinbottom = GYTOPY(ds.gwinbottom);
+  while (pwinleft*ds.xgupp < ds.gwinleft) pwinleft++;
+  while (pwinright*ds.xgupp > ds.gwinright) pwinright--;
+  while (ds.ygraphunits - (pwintop+1)*ds.ygupp > ds.gwintop) pwintop++;
+  while (ds.ygraphunits - (pwinbottom+1)*ds.ygupp < ds.gwinbottom) pwinbottom--;
+  if (pwinleft < 0) pwinleft = 0;
+  if (pwinright >= ds.screenwidth) pwinright = ds.screenwidth-1;
+  if (pwintop < 0) pwintop = 0;
+  if (pwinbottom >= ds.screenheight) pwinbottom = ds.screenheight-1;
+  *left = pwinleft;
+  *right = pwinright;
+  *top = pwintop;
+  *bottom = pwinbottom;
+  return pwinleft <= pwinright && pwintop <= pwinbottom;
+}
+
+/*
+** 'plot_span' plots the pixels from 'left' to 'right' inclusive on row 'y'
+** of 'surface' in colour 'colour' using GCOL action 'action', giving the
+** same result as calling plot_pixel() for each of them. The span is
+** clipped to the screen and graphics window once and the action is then
+** applied across the whole run. In 24-bit colour modes every action is
+** a mask applied to the pixel value. In modes with a palette each pixel
+** has to be matched with its colour number, so the result for the last
+** pixel value seen is kept as runs of the same colour are the norm
+*/
+static void plot_span(SDL_Surface *surface, int32 y, int32 left, int32 right, Uint32 colour, Uint32 action) {
+  int32 pwinleft, pwinright, pwintop, pwinbottom, x;
+  Uint32 *row, drawcolour;
+
+  if (action == 5) return;
+  if (left > right) {
+    x = left;
+    left = right;
+    right = x;
+  }
+  if (!window_pixels(&pwinleft, &pwintop, &pwinright, &pwinbottom)) return;
+  if (y < pwintop || y > pwinbottom || right < pwinleft || left > pwinright) return;
+  if (left < pwinleft) left = pwinleft;
+  if (right > pwinright) right = pwinright;
+  row = (Uint32*)surface->pixels + (int64)y*ds.vscrwidth;
+  if (action == 0 && ds.plot_inverse == 0) {
+    colour = SWAPENDIAN(colour);
+    for (x = left; x <= right; x++) row[x] = colour;
+    return;
+  }
+  if (ds.plot_inverse == 1) {
+    action = 3;
+    drawcolour = colourdepth-1;
   } else {
-    prevcolour=SWAPENDIAN(*((Uint32*)surface->pixels + offset));
-    prevcolour=emulate_colourfn((prevcolour >> 16) & 0xFF, (prevcolour >> 8) & 0xFF, (prevcolour & 0xFF));
+    drawcolour = ds.graph_physforecol;
+  }
+  if (colourdepth == COL24BIT) {
+/* The new colour is ((old AND andmask) OR ormask) EOR eormask, where 'old' is the RGB value as BGR */
+    Uint32 andmask = 0xFFFFFF, ormask = 0, eormask = 0;
     switch (action) {
-      case 1:
-        altcolour=(prevcolour | drawcolour);
-        break;
-      case 2:
-        altcolour=(prevcolour & drawcolour);
-        break;
-      case 3:
-        altcolour=(prevcolour ^ drawcolour);
-        break;
-      case 4:
-        altcolour=(prevcolour ^ (colourdepth-1));
-        break;
-      case 6:
-        altcolour=(prevcolour & ((~drawcolour) & (colourdepth-1)));
-        break;
-      case 7:
-        altcolour=(prevcolour | ((~drawcolour) & (colourdepth-1)));
-        break;
-      default:
-        altcolour=drawcolour; /* Invalid GCOL action code handled as 0 */
+      case 1: ormask = drawcolour; break;
+      case 2: andmask = drawcolour; break;
+      case 3: eormask = drawcolour; break;
+      case 4: eormask = 0xFFFFFF; break;
+      case 6: andmask = ~drawcolour; break;
+      case 7: ormask = ~drawcolour; break;
+      default: andmask = 0; ormask = drawcolour;
     }
-    if (colourdepth == COL24BIT) {
-      altcolour = altcolour & 0xFFFFFF;
-    } else {
-      a=altcolour;
-      altcolour=altcolour*3;
-      altcolour=SDL_MapRGB(sdl_fontbuf->format, palette[altcolour+0], palette[altcolour+1], palette[altcolour+2]) + (a << 24);
+    andmask &= 0xFFFFFF;
+    ormask &= 0xFFFFFF;
+    eormask &= 0xFFFFFF;
+    for (x = left; x <= right; x++) {
+      Uint32 pixel = SWAPENDIAN(row[x]);
+      pixel = ((pixel >> 16) & 0xFF) | (pixel & 0xFF00) | ((pixel & 0xFF) << 16);
+      pixel = ((pixel & andmask) | ormask) ^ eormask;
+      row[x] = SWAPENDIAN(pixel);
+    }
+  } else {
+    Uint32 lastpixel = row[left], lastresult = gcol_pixel(row[left], drawcolour, action);
+    for (x = left; x <= right; x++) {
+      if (row[x] != lastpixel) {
+        lastpixel = row[x];
+        lastresult = gcol_pixel(lastpixel, drawcolour, action);
+      }
+      row[x] = lastresult;
     }
   }
-  *((Uint32*)surface->pixels + offset) = SWAPENDIAN(altcolour);
 }
 
 /*
 ** 'flood_fill' floods fills an area of screen with the colour 'colour'.
-** x and y are the coordinates of the point at which to start. All
-** points that have the same colour as the one at (x, y) that can be
-** reached from (x, y) are set to colour 'colour'.
+** x and y are the coordinates of the point at which to start. If
+** 'tofore' is FALSE, all points that have the graphics background colour
+** that can be reached from (x, y) are filled (PLOT &80). If it is TRUE,
+** the fill spreads over everything up to the graphics foreground colour
+** (PLOT &88). The fill is confined to the graphics window.
 ** Note that the coordinates are *pixel* coordinates, that is, they are
 ** not expressed in graphics units.
 **
-** This code is slow but does the job, and is HIGHLY recursive (and memory hungry).
+** This is a scanline fill. Each run of matching pixels on a row is found
+** and filled in one go, and the start of each run of matching pixels in
+** the rows above and below it is pushed on to an explicit stack, so the
+** size of the area filled is not limited by the C stack. A bitmap marks
+** the pixels already filled as GCOL actions other than 0 can leave a
+** pixel with the colour being looked for.
 */
-// Attempt to reduce stack usage..
-int32 ffcolour, ffaction;
-
-static void flood_fill_inner(uint32 coord) {
-  int32 x=(coord & 0xFFFF);
-  int32 y=(coord >> 16);
-  if(basicvars.recdepth == basicvars.maxrecdepth) return;
-  if (*((Uint32*)screenbank[ds.writebank]->pixels + x + y*ds.vscrwidth) != ds.gb_colour) return;
-  basicvars.recdepth++;
-  plot_pixel(screenbank[ds.writebank], x, y, ffcolour, ffaction); /* Plot this pixel */
-  if (x >= 1) /* Left */
-    if (*((Uint32*)screenbank[ds.writebank]->pixels + (x-1) + y*ds.vscrwidth) == ds.gb_colour)
-      flood_fill_inner(x-1+(y<<16));
-  if (x < (ds.screenwidth-1)) /* Right */
-    if (*((Uint32*)screenbank[ds.writebank]->pixels + (x+1) + y*ds.vscrwidth) == ds.gb_colour)
-      flood_fill_inner(x+1+(y<<16));
-  if (y >= 1) /* Up */
-    if (*((Uint32*)screenbank[ds.writebank]->pixels + x + (y-1)*ds.vscrwidth) == ds.gb_colour)
-      flood_fill_inner(x+((y-1)<<16));
-  if (y < (ds.screenheight-1)) /* Down */
-    if (*((Uint32*)screenbank[ds.writebank]->pixels + x + (y+1)*ds.vscrwidth) == ds.gb_colour)
-      flood_fill_inner(x+((y+1)<<16));
-  basicvars.recdepth--;
-}
-
-static void flood_fill(int32 x, int32 y, int colour, Uint32 action) {
-  int32 pwinleft, pwinright, pwintop, pwinbottom;
-  if (colour == ds.gb_colour) return;
-  pwinleft = GXTOPX(ds.gwinleft);               /* Calculate extent of graphics window in pixels */
-  pwinright = GXTOPX(ds.gwinright);
-  pwintop = GYTOPY(ds.gwintop);
-  pwinbottom = GYTOPY(ds.gwinbottom);
+static void flood_fill(int32 x, int32 y, int colour, Uint32 action, boolean tofore) {
+  int32 pwinleft, pwinright, pwintop, pwinbottom, width, height;
+  int32 minx, maxx, miny, maxy, sp, stacksize;
+  Uint32 target, *pixels;
+  uint8 *done;
+  int32 *stack;
+
+  if (action == 5) return;
+  if (!tofore && colour == ds.gb_colour) return;
+  if (!window_pixels(&pwinleft, &pwintop, &pwinright, &pwinbottom)) return;
   if (x < pwinleft || x > pwinright || y < pwintop || y > pwinbottom) return;
-  ffcolour=colour;
-  ffaction=action;
-  if (*((Uint32*)screenbank[ds.writebank]->pixels + x + y*ds.vscrwidth) == ds.gb_colour)
-    flood_fill_inner(x+(y<<16));
+  width = pwinright-pwinleft+1;
+  height = pwinbottom-pwintop+1;
+  pixels = (Uint32*)screenbank[ds.writebank]->pixels;
+  target = tofore ? ds.gf_colour : ds.gb_colour;
+/* A pixel is to be filled if it has the background colour or, when filling up to the foreground, any other colour */
+#define DONEBIT(px, py) ((px)-pwinleft + ((py)-pwintop)*width)
+#define FILLABLE(px, py) (((pixels[(px) + (py)*ds.vscrwidth] == target) != tofore) && \
+  !(done[DONEBIT(px, py) >> 3] & (1 << (DONEBIT(px, py) & 7))))
+  done = calloc(((size_t)width*height+7)/8 + 1, 1);
+  stacksize = 1024;
+  stack = malloc(stacksize * 2 * sizeof(int32));
+  if (done == NIL || stack == NIL) {
+    free(done);
+    free(stack);
+    error(ERR_NOROOM);
+    return;
+  }
+  minx = maxx = x;
+  miny = maxy = y;
+  sp = 0;
+  stack[sp++] = x;
+  stack[sp++] = y;
+  while (sp > 0) {
+    int32 left, right, ny, n;
+    y = stack[--sp];
+    x = stack[--sp];
+    if (!FILLABLE(x, y)) continue;
+    left = right = x;
+    while (left > pwinleft && FILLABLE(left-1, y)) left--;
+    while (right < pwinright && FILLABLE(right+1, y)) right++;
+    for (n = left; n <= right; n++) done[DONEBIT(n, y) >> 3] |= 1 << (DONEBIT(n, y) & 7);
+    plot_span(screenbank[ds.writebank], y, left, right, colour, action);
+    if (left < minx) minx = left;
+    if (right > maxx) maxx = right;
+    if (y < miny) miny = y;
+    if (y > maxy) maxy = y;
+/* Push the start of each run of fillable pixels in the rows above and below */
+    for (ny = y-1; ny <= y+1; ny += 2) {
+      boolean inrun = FALSE;
+      if (ny < pwintop || ny > pwinbottom) continue;
+      for (n = left; n <= right; n++) {
+        if (!FILLABLE(n, ny)) {
+          inrun = FALSE;
+        } else if (!inrun) {
+          inrun = TRUE;
+          if (sp+2 > stacksize*2) {
+            int32 *newstack = realloc(stack, stacksize * 4 * sizeof(int32));
+            if (newstack == NIL) {
+              free(done);
+              free(stack);
+              error(ERR_NOROOM);
+              return;
+            }
+            stack = newstack;
+            stacksize *= 2;
+          }
+          stack[sp++] = n;
+          stack[sp++] = ny;
+        }
+      }
+    }
+  }
+#undef FILLABLE
+#undef DONEBIT
+  free(done);
+  free(stack);
   hide_cursor();
-  blit_scaled(0,0,ds.screenwidth-1,ds.screenheight-1);
+  blit_scaled(minx, miny, maxx, maxy);
   reveal_cursor();
 }
 #endif /* BRANDY_MODE7ONLY */
@@ -3164,7 +3629,10 @@ void emulate_plot(int32 code, int32 x, int32 y) {
       break;
     }
     case FLOOD_BACKGROUND:        /* Flood fill background with graphics foreground colour */
-      flood_fill(ex, ey, colour, action);
+      flood_fill(ex, ey, colour, action, FALSE);
+      break;
+    case FLOOD_FOREGROUND:        /* Flood fill up to the graphics foreground colour */
+      flood_fill(ex, ey, colour, action, TRUE);
       break;
     case SHIFT_RECTANGLE: {       /* Move or copy a rectangle */
       int32 destleft, destop, left, right, top, bottom;
@@ -3785,6 +4253,11 @@ boolean init_screen(void) {
   tmsg.bailout = -1;
 
   matrixflags.sdl_flags = SDL_DOUBLEBUF | SDL_HWSURFACE | SDL_ASYNCBLIT;
+  if (basicvars.runflags.headless) {
+    /* Draw into a software surface with SDL's 'dummy' driver, which has no window */
+    static char dummydriver[] = "SDL_VIDEODRIVER=dummy";
+    SDL_putenv(dummydriver);
+  }
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0) {
     fprintf(stderr, "Unable to init SDL: %s\n", SDL_GetError());
     return FALSE;
@@ -3805,6 +4278,10 @@ boolean init_screen(void) {
   reset_sysfont(0);
   if (basicvars.runflags.swsurface) matrixflags.sdl_flags = SDL_SWSURFACE | SDL_ASYNCBLIT;
   if (!matrixflags.neverfullscreen && basicvars.runflags.startfullscreen) matrixflags.sdl_flags |= SDL_FULLSCREEN;
+  if (basicvars.runflags.headless) {
+    matrixflags.sdl_flags = SDL_SWSURFACE;
+    matrixflags.neverfullscreen = TRUE;
+  }
   matrixflags.surface = SDL_SetVideoMode(640, 512, 32, matrixflags.sdl_flags); /* MODE 0 */
   if (!matrixflags.surface) {
     fprintf(stderr, "Failed to open screen: %s\n", SDL_GetError());
@@ -3924,6 +4401,7 @@ static void mode7renderline(int32 ypos, int32 fast) {
   set_rgb();
 
   vduflags &=0x0000FFFF; /* Clear the teletext flags which are reset on a new line */
+  mode7flashrow[ypos]=0;
 
   if (cursorstate == ONSCREEN) cursorstate = SUSPENDED;
   for (xt=0; xt<=39; xt++) {
@@ -3967,7 +4445,10 @@ static void mode7renderline(int32 ypos, int32 fast) {
     place_rect.x = xt*M7XPPC;
     place_rect.y = ypos*M7YPPC;
     SDL_FillRect(sdl_m7fontbuf, NULL, ds.tb_colour);
-    if (mode7flash) SDL_BlitSurface(sdl_m7fontbuf, &font_rect, screen3, &place_rect);
+    if (mode7flash) {
+      SDL_BlitSurface(sdl_m7fontbuf, &font_rect, screen3, &place_rect);
+      mode7flashrow[ypos]=1;
+    }
     xch=ch;
     if (vduflag(MODE7_HOLD) && ((ch >= 0x80 && ch <= 0x8C) || (ch >= 0x8E && ch <= 0x97 ) || (ch == 0x98 && vduflag(MODE7_REVEAL)) || (ch >= 0x99 && ch <= 0x9F))) {
       ch=mode7prevchar;
@@ -4099,6 +4580,90 @@ static void mode7renderscreen(void) {
   for (ypos=0; ypos<=24; ypos++) mode7renderline(ypos, 1);
 }
 
+/*
+** 'mode7blitrows' copies text rows 'first' to 'last' of 'bank', which is
+** either screen2 or screen3, to the display surface
+*/
+static void mode7blitrows(int32 first, int32 last, SDL_Surface *bank) {
+  int32 top = first*M7YPPC, bottom = (last+1)*M7YPPC-1;
+
+  if (bottom >= ds.screenheight) bottom = ds.screenheight-1;
+  if (matrixflags.videoscale != 1)
+    blit_scaled_actual2(0, top, ds.screenwidth-1, bottom, bank);
+  else {
+    SDL_Rect area = {0, top, ds.screenwidth, bottom-top+1};
+    SDL_Rect place = area;
+    SDL_BlitSurface(bank, &area, matrixflags.surface, &place);
+    add_damage(0, top, ds.screenwidth-1, bottom);
+  }
+}
+
+/*
+** 'mode7renderchanged' redraws the rows of the Mode 7 screen that have
+** changed since they were last drawn and copies them to the display
+** surface. Only the row itself affects how it is drawn, except for
+** double height text: the row below one containing a double height
+** code shows the bottom half of it, so that row is redrawn too when it
+** gains or loses its bottom half status. Everything is redrawn if
+** tmsg.mode7forcerefresh is set
+*/
+static void mode7renderchanged(void) {
+  Uint8 track[27], redraw[25];
+  int32 ypos, xpos, first;
+  boolean all = tmsg.mode7forcerefresh, changed = FALSE;
+
+  tmsg.mode7forcerefresh = 0;
+  memset(track, 0, sizeof(track));
+  for (ypos=0; ypos<=24; ypos++) {
+    if (track[ypos] < 2) {
+      for (xpos=0; xpos<=39; xpos++) {
+        if ((mode7frame[ypos][xpos] | 0x80) == TELETEXT_SIZE_DOUBLEHEIGHT) {
+          track[ypos] = 1;
+          track[ypos+1] = 2;
+          break;
+        }
+      }
+    }
+    redraw[ypos] = all || ((track[ypos] == 2) != (vdu141track[ypos] == 2)) || memcmp(mode7cloneframe[ypos], mode7frame[ypos], 40);
+    if (redraw[ypos]) changed = TRUE;
+  }
+  if (!changed) return;
+  memcpy(vdu141track, track, sizeof(track));
+  hide_cursor();
+  first = -1;
+  for (ypos=0; ypos<=25; ypos++) {
+    if (ypos <= 24 && redraw[ypos]) {
+      memcpy(mode7cloneframe[ypos], mode7frame[ypos], 40);
+      mode7renderline(ypos, 1);
+      if (first < 0) first = ypos;
+    } else if (first >= 0) {    /* Copy each run of redrawn rows in one go */
+      mode7blitrows(first, ypos-1, vduflag(MODE7_BANK) ? screen3 : screen2);
+      first = -1;
+    }
+  }
+  reveal_cursor();
+}
+
+/*
+** 'mode7flashrows' shows the rows of 'bank' that contain flashing
+** characters when the Mode 7 flash phase changes
+*/
+static void mode7flashrows(SDL_Surface *bank) {
+  int32 ypos, first = -1;
+
+  if (memchr(mode7flashrow, 1, 25) == NULL) return;     /* Nothing is flashing */
+  hide_cursor();
+  for (ypos=0; ypos<=25; ypos++) {
+    if (ypos <= 24 && mode7flashrow[ypos]) {
+      if (first < 0) first = ypos;
+    } else if (first >= 0) {
+      mode7blitrows(first, ypos-1, bank);
+      first = -1;
+    }
+  }
+  reveal_cursor();
+}
+
 #ifndef BRANDY_MODE7ONLY
 static void trace_edge(int32 x1, int32 y1, int32 x2, int32 y2) {
   int32 dx, dy, xf, yf, a, b, t, i;
@@ -4161,17 +4726,7 @@ static void trace_edge(int32 x1, int32 y1, int32 x2, int32 y2) {
 ** Draw a horizontal line
 */
 static void draw_h_line(SDL_Surface *sr, int32 x1, int32 x2, int32 y, Uint32 col, Uint32 action) {
-  if (x1 > x2) {
-    int32 tt = x1;
-    x1 = x2;
-    x2 = tt;
-  }
-  if (x1 >= ds.vscrwidth || x2 < 0 || y<0 || y>=ds.vscrheight) return;
-  if (x1 < 0) x1 = 0;
-  if (x2 >= ds.vscrwidth) x2 = ds.vscrwidth-1;
-  int32 i;
-  for (i = x1; i <= x2; i++)
-    plot_pixel(sr, i, y, col, action);
+  plot_span(sr, y, x1, x2, col, action);
 }
 
 /*
@@ -4639,6 +5194,7 @@ void fullscreenmode(int onoff) {
     SDL_BlitSurface(matrixflags.surface, NULL, screen1, NULL);
     matrixflags.surface = SDL_SetVideoMode(matrixflags.surface->w * matrixflags.videoscale, matrixflags.surface->h * matrixflags.videoscale, matrixflags.surface->format->BitsPerPixel, matrixflags.sdl_flags);
     SDL_BlitSurface(screen1, NULL, matrixflags.surface, NULL);
+    damage_all();
     SDL_WM_GrabInput(SDL_GRAB_OFF);
   }
   tmsg.modechange = -1;
@@ -4691,6 +5247,10 @@ void star_refresh(int flag) {
   if ((flag == 0) || (flag == 1) || (flag==2)) {
     ds.autorefresh=flag;
   }
+  if (basicvars.runflags.headless) {    /* There is no window to refresh */
+    if (flag == 3) dump_frame();
+    return;
+  }
   if (flag & 1) {
 #ifndef BRANDY_MODE7ONLY
     if (screenmode == 7) {
@@ -4701,6 +5261,7 @@ void star_refresh(int flag) {
       while (!matrixflags.videothreadbusy) usleep(1000);
       while (matrixflags.videothreadbusy) usleep(1000);
       ds.autorefresh=tmpflag;
+      if (flag == 3) dump_frame();
       return;
 #ifndef BRANDY_MODE7ONLY
     } else {
@@ -4711,12 +5272,92 @@ void star_refresh(int flag) {
     SDL_Flip(matrixflags.surface);
   }
   matrixflags.noupdate = 0;
+  if (flag == 3) dump_frame();
 }
 
 int get_refreshmode(void) {
   return ds.autorefresh;
 }
 
+/*
+** 'frame_clock' returns the time in microseconds for pacing frames
+*/
+static int64 frame_clock(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (int64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*
+** 'sdl_framerate' sets the number of frames per second that
+** sdl_framepresent() paces the display to and returns the previous
+** rate. While frames are paced the screen is not refreshed as it is
+** drawn on, as with *Refresh OnError, so the video thread leaves the
+** window alone and only sdl_framepresent() updates it until an error
+** turns refreshing back on. A rate of zero stops pacing and puts back
+** the *Refresh state in use before pacing started. Rates above
+** FRAMERATE_MAX are rejected, as no display can keep up with them and
+** the frame interval in microseconds has to stay well above zero
+*/
+int32 sdl_framerate(int32 rate) {
+  int32 previous = framepace.rate;
+
+  if (rate < 0 || rate > FRAMERATE_MAX) error(ERR_RANGE);
+  if (rate > 0 && framepace.rate == 0) {
+    framepace.refresh = ds.autorefresh;
+    framepace.due = frame_clock();
+  } else if (rate == 0 && framepace.rate > 0) {
+    star_refresh(framepace.refresh);
+  }
+  if (rate > 0 && ds.autorefresh != 2) star_refresh(2);
+  framepace.rate = rate;
+  return previous;
+}
+
+/*
+** 'sdl_framepresent' waits until the next frame is due and then copies
+** the screen to the window. If bit 0 of 'flags' is set and different
+** banks are being written to and displayed (*FX 112 and *FX 113) the
+** two banks are swapped first, so that the bank just drawn is shown
+** and the next frame is drawn in the other one. Frames are due at
+** regular intervals from when pacing was started. If the program has
+** fallen behind the frame is shown straight away and the function
+** returns the number of whole frames that were missed
+*/
+int32 sdl_framepresent(int32 flags) {
+  int64 now, interval;
+  int32 dropped = 0;
+
+#ifndef BRANDY_MODE7ONLY
+  if ((flags & 1) && screenmode != 7 && ds.writebank != ds.displaybank) {
+    uint32 bank = ds.displaybank;
+    ds.displaybank = ds.writebank;
+    ds.writebank = bank;
+    sysvar[250] = ds.writebank+1;
+    sysvar[251] = ds.displaybank+1;
+    matrixflags.modescreen_ptr = screenbank[ds.writebank]->pixels;
+  }
+#endif
+  if (framepace.rate > 0) {
+    interval = 1000000 / framepace.rate;
+    now = frame_clock();
+    if (now >= framepace.due) {
+      dropped = (now - framepace.due) / interval;
+      framepace.due += (int64)(dropped + 1) * interval;
+    } else {
+      if (framepace.due - now > interval) framepace.due = now + interval;       /* Clock has been set back */
+      while ((now = frame_clock()) < framepace.due) {
+        if (basicvars.escape) error(ERR_ESCAPE);
+        usleep((framepace.due - now) < 2000 ? (framepace.due - now) : 2000);
+      }
+      framepace.due += interval;
+    }
+  }
+  star_refresh(3);
+  return dropped;
+}
+
 int32 get_character_at_pos(int32 cx, int32 cy) {
   if ((cx < 0) || (cy < 0) || (cx > (twinright-twinleft)) || (cy > (twinbottom-twintop))) return -1;
   cx+=twinleft;
@@ -4829,6 +5470,7 @@ void screencopy(int32 src, int32 dst) {
   SDL_BlitSurface(screenbank[src-1],NULL,screenbank[dst-1],NULL);
   if (dst==(ds.displaybank+1)) {
     SDL_BlitSurface(screenbank[ds.displaybank], NULL, matrixflags.surface, NULL);
+    damage_all();
   }
 }
 
@@ -4972,6 +5614,7 @@ void osword8C(int64 x) {
   for (i=0; i<= 19; i++) {
     mode7font[offset][i] = block[(2*i)+5] + (256*block[(2*i)+4]);
   }
+  tmsg.mode7forcerefresh=1;
 }
 
 void swi_os_setcolour(int32 r0, int32 r1) {
@@ -4998,6 +5641,183 @@ void swi_os_setcolour(int32 r0, int32 r1) {
   }
 }
 
+static struct {
+  char name[FILENAME_MAX];      /* File name for frames saved by *FrameDump */
+  int32 every;                  /* Save every this many frames. 0 = *FrameDump is off */
+  int32 count;                  /* Frames since the last one saved */
+  int32 number;                 /* Number of the next frame saved */
+} framedump;
+
+/*
+** 'put32' stores 'value' at 'p' as a big-endian 32-bit number, as used in
+** PNG files
+*/
+static void put32(byte *p, uint32 value) {
+  p[0] = value >> 24;
+  p[1] = (value >> 16) & 0xFF;
+  p[2] = (value >> 8) & 0xFF;
+  p[3] = value & 0xFF;
+}
+
+/*
+** 'png_crc' updates the CRC-32 'crc' with 'len' bytes at 'data'
+*/
+static uint32 png_crc(uint32 crc, byte *data, size_t len) {
+  static uint32 crctable[256];
+  static boolean tablemade = FALSE;
+  size_t n;
+
+  if (!tablemade) {
+    uint32 c, i, k;
+    for (i = 0; i < 256; i++) {
+      c = i;
+      for (k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      crctable[i] = c;
+    }
+    tablemade = TRUE;
+  }
+  crc = ~crc;
+  for (n = 0; n < len; n++) crc = crctable[(crc ^ data[n]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+/*
+** 'png_chunk' writes a PNG chunk of type 'type' containing 'len' bytes at
+** 'data' to file 'f'. 'data' has eight bytes free in front of it, which
+** are used for the length and type of the chunk. It returns TRUE if the
+** chunk was written
+*/
+static boolean png_chunk(FILE *f, char *type, byte *data, size_t len) {
+  byte crc[4];
+
+  put32(data-8, len);
+  memcpy(data-4, type, 4);
+  put32(crc, png_crc(0, data-4, len+4));
+  return fwrite(data-8, 1, len+8, f) == len+8 && fwrite(crc, 1, 4, f) == 4;
+}
+
+/*
+** 'save_png' writes the contents of 'surface' to file 'fname' as a 24-bit
+** PNG image. The image data is stored without compression, which avoids
+** the need for zlib, so the file is about as large as a PPM file. It
+** returns zero if the file was written and -1 if not
+*/
+static int32 save_png(SDL_Surface *surface, char *fname) {
+  size_t rowlen = (size_t)surface->w*3 + 1, rawlen = rowlen*surface->h;
+  size_t blocks = (rawlen+65534)/65535, idatlen = 2 + rawlen + 5*blocks + 4;
+  uint32 adlera = 1, adlerb = 0;
+  byte *buffer, *idat, *raw, *p;
+  size_t n, left;
+  int32 x, y;
+  boolean ok;
+  FILE *f;
+
+/* The raw image goes at the end of the buffer and the IDAT chunk is built in front of it */
+  buffer = malloc(8 + 13 + 8 + idatlen + rawlen);
+  if (buffer == NIL) return -1;
+  idat = buffer + 8 + 13 + 8;
+  raw = idat + idatlen;
+  p = raw;
+  for (y = 0; y < surface->h; y++) {
+    Uint32 *row = (Uint32 *)((byte *)surface->pixels + y*surface->pitch);
+    *p++ = 0;                   /* Filter type 0 (none) */
+    for (x = 0; x < surface->w; x++) {
+      SDL_GetRGB(row[x], surface->format, p, p+1, p+2);
+      p += 3;
+    }
+  }
+/* Wrap the raw data in a zlib stream made of stored deflate blocks */
+  p = idat;
+  *p++ = 0x78;
+  *p++ = 0x01;
+  for (n = 0; n < rawlen; n += 65535) {
+    left = rawlen-n > 65535 ? 65535 : rawlen-n;
+    *p++ = n+left == rawlen;    /* Set the 'final block' bit on the last one */
+    *p++ = left & 0xFF;
+    *p++ = left >> 8;
+    *p++ = ~left & 0xFF;
+    *p++ = (~left >> 8) & 0xFF;
+    memmove(p, raw+n, left);
+    p += left;
+  }
+  for (n = 0; n < rawlen; n++) {
+    adlera = (adlera + raw[n]) % 65521;
+    adlerb = (adlerb + adlera) % 65521;
+  }
+  put32(p, (adlerb << 16) | adlera);
+  f = fopen(fname, "wb");
+  if (f == NIL) {
+    free(buffer);
+    return -1;
+  }
+  p = buffer + 8;
+  put32(p, surface->w);
+  put32(p+4, surface->h);
+  p[8] = 8;                     /* Eight bits per sample */
+  p[9] = 2;                     /* Truecolour */
+  p[10] = p[11] = p[12] = 0;    /* Default compression and filters, not interlaced */
+  ok = fwrite("\x89PNG\r\n\x1a\n", 1, 8, f) == 8 && png_chunk(f, "IHDR", p, 13);
+  ok = ok && png_chunk(f, "IDAT", idat, idatlen);
+  ok = ok && png_chunk(f, "IEND", idat, 0);
+  free(buffer);
+  if (fclose(f) != 0) ok = FALSE;
+  return ok ? 0 : -1;
+}
+
+/*
+** 'save_ppm' writes the contents of 'surface' to file 'fname' as a binary
+** PPM image. It returns zero if the file was written and -1 if not
+*/
+static int32 save_ppm(SDL_Surface *surface, char *fname) {
+  byte *line;
+  int32 x, y;
+  boolean ok;
+  FILE *f;
+
+  line = malloc((size_t)surface->w*3);
+  if (line == NIL) return -1;
+  f = fopen(fname, "wb");
+  if (f == NIL) {
+    free(line);
+    return -1;
+  }
+  ok = fprintf(f, "P6\n%d %d\n255\n", surface->w, surface->h) > 0;
+  for (y = 0; ok && y < surface->h; y++) {
+    Uint32 *row = (Uint32 *)((byte *)surface->pixels + y*surface->pitch);
+    for (x = 0; x < surface->w; x++) SDL_GetRGB(row[x], surface->format, line+x*3, line+x*3+1, line+x*3+2);
+    ok = fwrite(line, 3, surface->w, f) == surface->w;
+  }
+  free(line);
+  if (fclose(f) != 0) ok = FALSE;
+  return ok ? 0 : -1;
+}
+
+/*
+** 'save_screen' saves the screen to file 'fname'. The format of the file
+** is chosen by its extension: '.png' for PNG, '.ppm' for PPM and anything
+** else for a Windows bitmap
+*/
+static void save_screen(char *fname) {
+  SDL_Surface *surface = (screenmode == 7) ? screen2 : matrixflags.surface;
+  char *ext = strrchr(fname, '.');
+  int32 result;
+
+  if (basicvars.runflags.headless) {   /* Bring the screen up to date as nothing else does */
+#ifndef BRANDY_MODE7ONLY
+    if (screenmode != 7) blit_scaled_actual(0, 0, ds.screenwidth-1, ds.screenheight-1);
+    else
+#endif
+      mode7renderscreen();
+  }
+  if (ext != NIL && !strcasecmp(ext, ".png"))
+    result = save_png(surface, fname);
+  else if (ext != NIL && !strcasecmp(ext, ".ppm"))
+    result = save_ppm(surface, fname);
+  else
+    result = SDL_SaveBMP(surface, fname);
+  if (result) error(ERR_CANTWRITE);
+}
+
 void sdl_screensave(char *fname) {
   /* Strip quote marks, where appropriate */
   if ((fname[0] == '"') && (fname[strlen(fname)-1] == '"')) {
@@ -5005,9 +5825,51 @@ void sdl_screensave(char *fname) {
     fname++;
   }
 
-  if (SDL_SaveBMP((screenmode == 7) ? screen2 : matrixflags.surface, fname)) {
-    error(ERR_CANTWRITE);
+  save_screen(fname);
+}
+
+/*
+** 'sdl_framedump' deals with *FrameDump. From now on the screen is saved
+** to a file every 'every' times the display is refreshed with *Refresh.
+** Any run of '#' characters in 'fname' is replaced by the frame number.
+** An empty file name stops saving frames
+*/
+void sdl_framedump(char *fname, int32 every) {
+  if ((fname[0] == '"') && (fname[strlen(fname)-1] == '"')) {
+    fname[strlen(fname)-1] = '\0';
+    fname++;
+  }
+  if (*fname == '\0' || every < 1) {
+    framedump.every = 0;
+    return;
+  }
+  STRLCPY(framedump.name, fname, sizeof(framedump.name));
+  framedump.every = every;
+  framedump.count = 0;
+  framedump.number = 0;
+}
+
+/*
+** 'dump_frame' is called each time the display is refreshed with *Refresh
+** and saves every n'th frame when *FrameDump is active
+*/
+static void dump_frame(void) {
+  char name[FILENAME_MAX + 16], *hash;
+  int32 digits;
+
+  if (framedump.every == 0) return;
+  framedump.count++;
+  if (framedump.count < framedump.every) return;
+  framedump.count = 0;
+  hash = strchr(framedump.name, '#');
+  if (hash == NIL) {
+    STRLCPY(name, framedump.name, sizeof(name));
+  } else {
+    for (digits = 0; hash[digits] == '#'; digits++);
+    snprintf(name, sizeof(name), "%.*s%0*d%s", (int)(hash-framedump.name), framedump.name, digits, framedump.number, hash+digits);
   }
+  framedump.number++;
+  save_screen(name);
 }
 
 void sdl_screenload(char *fname) {
@@ -5026,11 +5888,416 @@ void sdl_screenload(char *fname) {
     SDL_BlitSurface(placeholder, NULL, screenbank[ds.writebank], NULL);
     if (ds.displaybank == ds.writebank) {
       SDL_BlitSurface(placeholder, NULL, matrixflags.surface, NULL);
+      damage_all();
     }
     SDL_FreeSurface(placeholder);
   }
 }
 
+#ifndef BRANDY_MODE7ONLY
+/*
+** Sprites are images held in memory that can be plotted anywhere on the
+** graphics screen. Each one is identified by a handle from 1 to MAXSPRITES.
+** The pixels are kept as &AARRGGBB words, and a second copy of them is kept
+** in the form they are stored in the screen buffer in 24-bit colour modes,
+** so that a sprite plotted with GCOL action 0 and no transparency in those
+** modes can be copied to the screen a row at a time
+*/
+#define MAXSPRITES 256
+
+#define SPRITE_KEYED 1          /* Pixels matching the colour key are not plotted */
+#define SPRITE_ALPHA 2          /* Pixels are blended with the screen using their alpha values */
+
+static struct {
+  int32 width, height;
+  boolean hasalpha;     /* TRUE if any pixel is not fully opaque */
+  Uint32 *pixels;       /* Pixels as &AARRGGBB */
+  Uint32 *screen;       /* Pixels as stored in the screen buffer in 24-bit colour modes */
+} sprites[MAXSPRITES];
+
+/*
+** 'ppm_number' reads the next number from the header of a PPM file,
+** skipping white space and comments. It returns -1 if there is not one
+*/
+static int32 ppm_number(FILE *f) {
+  int32 ch, value = 0;
+
+  do {
+    ch = fgetc(f);
+    if (ch == '#') {
+      while (ch != EOF && ch != '\n') ch = fgetc(f);
+    }
+  } while (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n');
+  if (ch < '0' || ch > '9') return -1;
+  while (ch >= '0' && ch <= '9' && value < 0x1000000) {
+    value = value*10 + ch - '0';
+    ch = fgetc(f);
+  }
+  return value;
+}
+
+/*
+** 'load_ppm' reads the binary PPM image in file 'fname', returning its
+** pixels as &AARRGGBB words and its size in 'width' and 'height'. It
+** returns NIL if the file cannot be read or is not a PPM file
+*/
+static Uint32 *load_ppm(char *fname, int32 *width, int32 *height) {
+  Uint32 *pixels;
+  byte rgb[3];
+  int32 n, maxval;
+  FILE *f;
+
+  f = fopen(fname, "rb");
+  if (f == NIL) return NIL;
+  if (fgetc(f) != 'P' || fgetc(f) != '6') {
+    fclose(f);
+    return NIL;
+  }
+  *width = ppm_number(f);
+  *height = ppm_number(f);
+  maxval = ppm_number(f);
+  if (*width <= 0 || *height <= 0 || maxval != 255) {   /* Only eight bits per colour component are supported */
+    fclose(f);
+    return NIL;
+  }
+  pixels = malloc((size_t)*width * *height * sizeof(Uint32));
+  if (pixels == NIL) {
+    fclose(f);
+    return NIL;
+  }
+  for (n = 0; n < *width * *height; n++) {
+    if (fread(rgb, 1, 3, f) != 3) {
+      free(pixels);
+      fclose(f);
+      return NIL;
+    }
+    pixels[n] = 0xFF000000 | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+  }
+  fclose(f);
+  return pixels;
+}
+
+/*
+** 'load_bmp' reads the Windows bitmap in file 'fname' using SDL, returning
+** its pixels as &AARRGGBB words and its size in 'width' and 'height'. The
+** alpha values are only meaningful if the image has an alpha channel.
+** It returns NIL if the file cannot be read
+*/
+static Uint32 *load_bmp(char *fname, int32 *width, int32 *height) {
+  SDL_Surface *image, *argb, *converted;
+  Uint32 *pixels;
+  int32 y;
+
+  image = SDL_LoadBMP(fname);
+  if (image == NIL) return NIL;
+  argb = SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, 32, 0xFF0000, 0xFF00, 0xFF, 0xFF000000);
+  if (argb == NIL) {
+    SDL_FreeSurface(image);
+    return NIL;
+  }
+  converted = SDL_ConvertSurface(image, argb->format, SDL_SWSURFACE);
+  SDL_FreeSurface(argb);
+  SDL_FreeSurface(image);
+  if (converted == NIL) return NIL;
+  *width = converted->w;
+  *height = converted->h;
+  pixels = malloc((size_t)*width * *height * sizeof(Uint32));
+  if (pixels != NIL) {
+    SDL_LockSurface(converted);
+    for (y = 0; y < *height; y++) memcpy(pixels + (size_t)y * *width, (byte *)converted->pixels + y*converted->pitch, *width * sizeof(Uint32));
+    SDL_UnlockSurface(converted);
+  }
+  SDL_FreeSurface(converted);
+  return pixels;
+}
+
+/*
+** 'new_sprite' adds the image held in 'pixels' to the sprite pool,
+** returning its handle. 'pixels' becomes the property of the pool
+*/
+static int32 new_sprite(Uint32 *pixels, int32 width, int32 height) {
+  int32 handle, n;
+  Uint32 *screen;
+
+  for (handle = 0; handle < MAXSPRITES && sprites[handle].pixels != NIL; handle++);
+  screen = malloc((size_t)width*height*sizeof(Uint32));
+  if (handle == MAXSPRITES || screen == NIL) {
+    free(pixels);
+    free(screen);
+    error(ERR_SPRITEFULL);
+    return 0;
+  }
+  sprites[handle].width = width;
+  sprites[handle].height = height;
+  sprites[handle].hasalpha = FALSE;
+  sprites[handle].pixels = pixels;
+  sprites[handle].screen = screen;
+  for (n = 0; n < width*height; n++) {
+    if ((pixels[n] >> 24) != 0xFF) sprites[handle].hasalpha = TRUE;
+    screen[n] = SWAPENDIAN(SDL_MapRGB(sdl_fontbuf->format, (pixels[n] >> 16) & 0xFF, (pixels[n] >> 8) & 0xFF, pixels[n] & 0xFF));
+  }
+  return handle+1;
+}
+
+/*
+** 'find_sprite' returns the index in the sprite pool of the sprite with
+** handle 'handle', reporting an error if there is no such sprite
+*/
+static int32 find_sprite(int32 handle) {
+  if (handle < 1 || handle > MAXSPRITES || sprites[handle-1].pixels == NIL) error(ERR_NOSPRITE);
+  return handle-1;
+}
+
+/*
+** 'sdl_spriteload' loads the image in file 'fname' into the sprite pool,
+** returning its handle. The file can be a binary PPM image or anything
+** that SDL_LoadBMP() can read
+*/
+int32 sdl_spriteload(char *fname) {
+  Uint32 *pixels;
+  int32 width, height;
+
+  pixels = load_ppm(fname, &width, &height);
+  if (pixels == NIL) pixels = load_bmp(fname, &width, &height);
+  if (pixels == NIL) {
+    error(ERR_CANTREAD);
+    return 0;
+  }
+  return new_sprite(pixels, width, height);
+}
+
+/*
+** 'sdl_spritegrab' copies the part of the graphics screen with corners
+** (x1, y1) and (x2, y2) into the sprite pool, returning its handle. The
+** coordinates are relative to the graphics origin
+*/
+int32 sdl_spritegrab(int32 x1, int32 y1, int32 x2, int32 y2) {
+  int32 left, right, top, bottom, x, y, t;
+  Uint32 *pixels, *p;
+
+  if (istextonly()) error(ERR_BADMODE);
+  left = GXTOPX(x1+ds.xorigin);
+  right = GXTOPX(x2+ds.xorigin);
+  top = GYTOPY(y2+ds.yorigin);
+  bottom = GYTOPY(y1+ds.yorigin);
+  if (left > right) {
+    t = left;
+    left = right;
+    right = t;
+  }
+  if (top > bottom) {
+    t = top;
+    top = bottom;
+    bottom = t;
+  }
+  if (left < 0) left = 0;
+  if (top < 0) top = 0;
+  if (right >= ds.screenwidth) right = ds.screenwidth-1;
+  if (bottom >= ds.screenheight) bottom = ds.screenheight-1;
+  if (left > right || top > bottom) error(ERR_RANGE);
+  pixels = malloc((size_t)(right-left+1)*(bottom-top+1)*sizeof(Uint32));
+  if (pixels == NIL) {
+    error(ERR_SPRITEFULL);
+    return 0;
+  }
+  p = pixels;
+  for (y = top; y <= bottom; y++) {
+    Uint32 *row = (Uint32*)screenbank[ds.writebank]->pixels + (int64)y*ds.vscrwidth;
+    for (x = left; x <= right; x++) *p++ = 0xFF000000 | (SWAPENDIAN(row[x]) & 0xFFFFFF);
+  }
+  return new_sprite(pixels, right-left+1, bottom-top+1);
+}
+
+/*
+** 'sdl_spriteinfo' returns the size of sprite 'handle' in pixels in
+** 'width' and 'height'. 'hasalpha' is set to TRUE if any of its pixels
+** is not fully opaque
+*/
+void sdl_spriteinfo(int32 handle, int32 *width, int32 *height, boolean *hasalpha) {
+  int32 n = find_sprite(handle);
+
+  *width = sprites[n].width;
+  *height = sprites[n].height;
+  *hasalpha = sprites[n].hasalpha;
+}
+
+/*
+** 'sdl_spritefree' removes sprite 'handle' from the sprite pool. A handle
+** of -1 empties the pool
+*/
+void sdl_spritefree(int32 handle) {
+  int32 n;
+
+  if (handle == -1) {
+    for (n = 0; n < MAXSPRITES; n++) {
+      free(sprites[n].pixels);
+      free(sprites[n].screen);
+      sprites[n].pixels = sprites[n].screen = NIL;
+    }
+    return;
+  }
+  n = find_sprite(handle);
+  free(sprites[n].pixels);
+  free(sprites[n].screen);
+  sprites[n].pixels = sprites[n].screen = NIL;
+}
+
+/*
+** 'colourmatch' holds the last colour matched by match_colour(). A sprite
+** usually has runs of the same colour and in modes with a palette finding
+** the nearest palette entry is slow
+*/
+typedef struct {
+  Uint32 rgb;           /* Colour as &RRGGBB */
+  Uint32 pixel;         /* Pixel value to store in the screen buffer */
+  Uint32 colnum;        /* Colour number to use with GCOL actions other than 0 */
+} colourmatch;
+
+/*
+** 'match_colour' updates 'match' for colour 'rgb' (&RRGGBB). In modes with
+** a palette the colour is replaced by the nearest palette entry, and the
+** colour number is the palette entry in the same form as the graphics
+** foreground colour that plot_pixel() uses
+*/
+static void match_colour(Uint32 rgb, colourmatch *match) {
+  int32 n, red, green, blue, best = 0, distance = 0x7fffffff;
+
+  if (rgb == match->rgb) return;
+  red = (rgb >> 16) & 0xFF;
+  green = (rgb >> 8) & 0xFF;
+  blue = rgb & 0xFF;
+  match->rgb = rgb;
+  if (colourdepth == COL24BIT) {
+    match->pixel = SWAPENDIAN(SDL_MapRGB(sdl_fontbuf->format, red, green, blue));
+    match->colnum = red + (green << 8) + (blue << 16);
+    return;
+  }
+  for (n = 0; n < colourdepth && distance != 0; n++) {
+    int32 dr = palette[n * 3 + 0] - red;
+    int32 dg = palette[n * 3 + 1] - green;
+    int32 db = palette[n * 3 + 2] - blue;
+    int32 test = 2 * dr * dr + 4 * dg * dg + db * db;
+    if (test < distance) {
+      distance = test;
+      best = n;
+    }
+  }
+  match->colnum = best;
+  match->pixel = SDL_MapRGB(sdl_fontbuf->format, palette[best*3], palette[best*3+1], palette[best*3+2]) + ((colourdepth == 256 ? best >> COL256SHIFT : best) << 24);
+  match->pixel = SWAPENDIAN(match->pixel);
+}
+
+/*
+** 'sprite_row' is the row kernel used to plot sprites. It plots the pixels
+** from 'left' to 'right' inclusive of screen row 'row', taking them from
+** row 'sy' of sprite 'n'. 'xmap' gives the sprite column for each screen
+** column from 'left', or is NIL if the sprite is not scaled horizontally
+** and column 'left' shows sprite column 'sx'. 'flags' says whether the
+** colour key 'key' and the pixels' alpha values are used and 'action' is
+** the GCOL action. 'match' holds the last colour matched
+*/
+static void sprite_row(Uint32 *row, int32 n, int32 sy, int32 sx, int32 left, int32 right, int32 *xmap, int32 flags, Uint32 key, int32 action, colourmatch *match) {
+  Uint32 *src = sprites[n].pixels + (size_t)sy*sprites[n].width;
+  Uint32 *screen = sprites[n].screen + (size_t)sy*sprites[n].width;
+  int32 x, i, alpha;
+
+/* Opaque sprite, unscaled, GCOL action 0 in a 24-bit mode: copy the row */
+  if (flags == 0 && action == 0 && xmap == NIL && colourdepth == COL24BIT) {
+    memcpy(row+left, screen+sx, (right-left+1)*sizeof(Uint32));
+    return;
+  }
+  for (x = left; x <= right; x++) {
+    Uint32 argb, rgb;
+    i = (xmap == NIL) ? sx+x-left : xmap[x-left];
+    argb = src[i];
+    rgb = argb & 0xFFFFFF;
+    if ((flags & SPRITE_KEYED) && rgb == key) continue;
+    alpha = (flags & SPRITE_ALPHA) ? argb >> 24 : 0xFF;
+    if (alpha == 0) continue;
+    if (alpha != 0xFF) {
+      Uint32 old = SWAPENDIAN(row[x]);
+      int32 red = ((old >> 16) & 0xFF) + (((int32)((rgb >> 16) & 0xFF) - (int32)((old >> 16) & 0xFF)) * alpha) / 255;
+      int32 green = ((old >> 8) & 0xFF) + (((int32)((rgb >> 8) & 0xFF) - (int32)((old >> 8) & 0xFF)) * alpha) / 255;
+      int32 blue = (old & 0xFF) + (((int32)(rgb & 0xFF) - (int32)(old & 0xFF)) * alpha) / 255;
+      rgb = (red << 16) | (green << 8) | blue;
+    } else if (action == 0 && colourdepth == COL24BIT) {
+      row[x] = screen[i];
+      continue;
+    }
+    match_colour(rgb, match);
+    row[x] = (action == 0) ? match->pixel : gcol_pixel(row[x], match->colnum, action);
+  }
+}
+
+/*
+** 'sdl_spriteplot' plots sprite 'handle' with its bottom left-hand corner
+** at (x, y) on the graphics screen, relative to the graphics origin, using
+** the current graphics foreground GCOL action. It is scaled to 'width' by
+** 'height' pixels if these are not zero. If bit 0 of 'flags' is set pixels
+** with the colour 'key' (&RRGGBB) are left out, and if bit 1 is set the
+** pixels are blended with the screen using their alpha values. The sprite
+** is clipped to the graphics window
+*/
+void sdl_spriteplot(int32 handle, int32 x, int32 y, int32 flags, int32 key, int32 width, int32 height) {
+  int32 n, left, right, top, bottom, pwinleft, pwinright, pwintop, pwinbottom, action, px, py;
+  int32 *xmap = NIL;
+  colourmatch match = {0xFFFFFFFF, 0, 0};      /* No colour matched yet */
+
+  n = find_sprite(handle);
+  if (istextonly()) return;
+  action = ds.graph_fore_action;
+  if (action == 5) return;
+  if (width <= 0) width = sprites[n].width;
+  if (height <= 0) height = sprites[n].height;
+  left = GXTOPX(x+ds.xorigin);
+  bottom = GYTOPY(y+ds.yorigin);
+  right = left+width-1;
+  top = bottom-height+1;
+  if (!window_pixels(&pwinleft, &pwintop, &pwinright, &pwinbottom)) return;
+  if (right < pwinleft || left > pwinright || bottom < pwintop || top > pwinbottom) return;
+  px = (left < pwinleft) ? pwinleft : left;
+  if (right > pwinright) right = pwinright;
+  py = (top < pwintop) ? pwintop : top;
+  if (bottom > pwinbottom) bottom = pwinbottom;
+  if (width != sprites[n].width) {
+    int32 i;
+    xmap = malloc((right-px+1)*sizeof(int32));
+    if (xmap == NIL) error(ERR_SPRITEFULL);
+    for (i = 0; i <= right-px; i++) xmap[i] = ((int64)(px-left+i)*sprites[n].width)/width;
+  }
+  flags &= SPRITE_KEYED | SPRITE_ALPHA;
+  key &= 0xFFFFFF;
+  hide_cursor();
+  for (y = py; y <= bottom; y++) {
+    sprite_row((Uint32*)screenbank[ds.writebank]->pixels + (int64)y*ds.vscrwidth, n, ((int64)(y-top)*sprites[n].height)/height, px-left, px, right, xmap, flags, key, action, &match);
+  }
+  free(xmap);
+  blit_scaled(px, py, right, bottom);
+  reveal_cursor();
+}
+#else
+int32 sdl_spriteload(char *fname) {
+  error(ERR_BADMODE);
+  return 0;
+}
+
+int32 sdl_spritegrab(int32 x1, int32 y1, int32 x2, int32 y2) {
+  error(ERR_BADMODE);
+  return 0;
+}
+
+void sdl_spriteinfo(int32 handle, int32 *width, int32 *height, boolean *hasalpha) {
+  error(ERR_BADMODE);
+}
+
+void sdl_spritefree(int32 handle) {
+}
+
+void sdl_spriteplot(int32 handle, int32 x, int32 y, int32 flags, int32 key, int32 width, int32 height) {
+  error(ERR_BADMODE);
+}
+#endif /* BRANDY_MODE7ONLY */
+
 void swi_swap16palette() {
 #ifndef BRANDY_MODE7ONLY
   Uint8 place;
@@ -5137,7 +6404,7 @@ size_t readmodevariable(int32 scrmode, int32 var) {
   }
 }
 
-/* Refreshes the display approximately every 15ms. Also implements MODE7 flash */
+/* Refreshes the parts of the display that have changed approximately every 15ms. Also implements MODE7 flash */
 int videoupdatethread(void) {
   int64 mytime = 0;
   
@@ -5169,37 +6436,21 @@ int videoupdatethread(void) {
       exit_interpreter_real(tmsg.bailout);
     } else {
       mytime = basicvars.centiseconds;
-      SDL_PumpEvents(); /* This is for the keyboard stuff */
-      if (matrixflags.noupdate == 0 && matrixflags.videothreadbusy == 0 && ds.autorefresh == 1 && matrixflags.surface) {
+      if (!basicvars.runflags.headless) SDL_PumpEvents(); /* This is for the keyboard stuff */
+      if (!basicvars.runflags.headless && matrixflags.noupdate == 0 && matrixflags.videothreadbusy == 0 && ds.autorefresh == 1 && matrixflags.surface) {
         matrixflags.videothreadbusy = 1;
         if (screenmode == 7) {
-          if (tmsg.mode7forcerefresh || memcmp(mode7cloneframe, mode7frame, 1000)) {
-            memcpy(mode7cloneframe, mode7frame, 1000);
-            tmsg.mode7forcerefresh = 0;
-            mode7renderscreen();
-            if (matrixflags.videoscale != 1)
-              blit_scaled_actual2(0, 0, ds.screenwidth-1, ds.screenheight-1, vduflag(MODE7_BANK) ? screen3 :  screen2);
-            else
-              SDL_BlitSurface(vduflag(MODE7_BANK) ? screen3 :  screen2, NULL, matrixflags.surface, NULL);
-          }
+          mode7renderchanged();
           if ((mode7timer - mytime) <= 0) {
-            hide_cursor();
             if (vduflag(MODE7_BANK)) {
-              if (matrixflags.videoscale != 1)
-                blit_scaled_actual2(0, 0, ds.screenwidth-1, ds.screenheight-1, screen2);
-              else
-                SDL_BlitSurface(screen2, NULL, matrixflags.surface, NULL);
+              mode7flashrows(screen2);
               write_vduflag(MODE7_BANK,0);
               mode7timer=mytime + 96;
             } else {
-              if (matrixflags.videoscale != 1)
-                blit_scaled_actual2(0, 0, ds.screenwidth-1, ds.screenheight-1, screen3);
-              else
-                SDL_BlitSurface(screen3, NULL, matrixflags.surface, NULL);
+              mode7flashrows(screen3);
               write_vduflag(MODE7_BANK,1);
               mode7timer=mytime + 32;
             }
-            reveal_cursor();
           }
         }
 #ifndef BRANDY_MODE7ONLY
@@ -5213,7 +6464,7 @@ int videoupdatethread(void) {
             hide_cursor();
           }
         }
-        SDL_Flip(matrixflags.surface);
+        update_display();
         matrixflags.videothreadbusy = 0;
       }
     }
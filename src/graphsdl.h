@@ -71,7 +71,15 @@ extern void osword8C(int64 x);
 extern void swi_os_setcolour(int32 r0, int32 r1);
 extern int32 os_readpalette(int32 colour, int32 mode);
 extern void sdl_screensave(char *fname);
+extern void sdl_framedump(char *fname, int32 every);
 extern void sdl_screenload(char *fname);
+extern int32 sdl_spriteload(char *fname);
+extern int32 sdl_spritegrab(int32 x1, int32 y1, int32 x2, int32 y2);
+extern void sdl_spriteplot(int32 handle, int32 x, int32 y, int32 flags, int32 key, int32 width, int32 height);
+extern void sdl_spriteinfo(int32 handle, int32 *width, int32 *height, boolean *hasalpha);
+extern void sdl_spritefree(int32 handle);
+extern int32 sdl_framerate(int32 rate);
+extern int32 sdl_framepresent(int32 flags);
 extern void swi_swap16palette(void);
 extern size_t readmodevariable(int32 scrmode, int32 var);
 extern void screencopy(int32 src, int32 dst);
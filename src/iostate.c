@@ -447,6 +447,7 @@ void exec_bput(void) {
       return;
     }
   } while (TRUE);
+  fileio_endwrite(handle);
   DEBUGFUNCMSGOUT;
 }
 
@@ -1913,6 +1914,7 @@ static void print_file(void) {
     }
     more = !ateol[*basicvars.current];
   }
+  fileio_endwrite(handle);
   DEBUGFUNCMSGOUT;
 }
 
@@ -271,6 +271,58 @@ static void do_arrayvar(lvalue *destination) {
   DEBUGFUNCMSGOUT;
 }
 
+/*
+** 'element_lvalue' fills in the lvalue structure for element 'element'
+** of array 'vp'. basicvars.current points at the character after the
+** ')'. The reference can be followed by an indirection operator
+*/
+static void element_lvalue(lvalue *destination, variable *vp, int32 element) {
+  int32 vartype;
+  size_t offset = 0;
+  basicarray *descriptor = vp->varentry.vararray;
+
+  DEBUGFUNCMSGIN;
+  destination->typeinfo = vartype = vp->varflags-VAR_ARRAY;     /* Clear the 'array' bit */
+  if (*basicvars.current!='?' && *basicvars.current!='!') {
+/* There is nothing after the array ref - Finish off and return home */
+/* Calculate the address of the required element */
+    switch(vartype) {
+      case VAR_INTWORD: destination->address.intaddr = descriptor->arraystart.intbase+element; break;
+      case VAR_UINT8:   destination->address.uint8addr = descriptor->arraystart.uint8base+element; break;
+      case VAR_INTLONG: destination->address.int64addr = descriptor->arraystart.int64base+element; break;
+      case VAR_FLOAT:   destination->address.floataddr = descriptor->arraystart.floatbase+element; break;
+      default: destination->address.straddr = descriptor->arraystart.stringbase+element; /* string */
+    }
+    DEBUGFUNCMSGOUT;
+    return;
+  }
+/*
+** The array reference is followed by an indirection operator.
+** Fetch the value of the array element. This will provide the value
+** for the left-hand side of the operator
+*/
+  switch(vartype) {
+    case VAR_INTWORD: offset = descriptor->arraystart.intbase[element]; break;
+    case VAR_UINT8:   offset = descriptor->arraystart.uint8base[element]; break;
+    case VAR_INTLONG: offset = descriptor->arraystart.int64base[element]; break;
+    case VAR_FLOAT:   offset = TONATIVEADDR(descriptor->arraystart.floatbase[element]); break;
+    default: 
+      DEBUGFUNCMSGOUT;
+      error(ERR_VARNUM);
+      return;
+  }
+/* Now deal with the indirection operator */
+  if (*basicvars.current=='?')          /* Result of operator is a single byte integer */
+    destination->typeinfo = VAR_INTBYTEPTR;
+  else {                                /* Result of operator is a four byte integer */
+    destination->typeinfo = VAR_INTWORDPTR;
+  }
+  basicvars.current++;  /* Skip the operator */
+  factor();             /* Evaluate the RH operand */
+  destination->address.offset = offset+pop_anynum64();
+  DEBUGFUNCMSGOUT;
+}
+
 /*
 ** 'do_elementvar' fills in the lvalue structure for a reference to
 ** an element of an array. This can be followed by an indirection
@@ -278,13 +330,13 @@ static void do_arrayvar(lvalue *destination) {
 */
 static void do_elementvar(lvalue *destination) {
   variable *vp;
-  int32 vartype, offset = 0, element = 0;
+  int32 element = 0;
   basicarray *descriptor;
+  byte *tp = basicvars.current;
 
   DEBUGFUNCMSGIN;
   vp = GET_ADDRESS(basicvars.current, variable *);
   basicvars.current+=LOFFSIZE+1;                /* Skip the pointer to the array's address */
-  vartype = vp->varflags;
   descriptor = vp->varentry.vararray;
   if (descriptor->dimcount==1) {        /* Shortcut for single dimension arrays */
     expression();       /* Evaluate the array index */
@@ -306,22 +358,22 @@ static void do_elementvar(lvalue *destination) {
         error(ERR_BADINDEX, index, vp->varname);
         return;
       }
-      element+=index;
+      element = element*descriptor->dimsize[dimcount]+index;
       dimcount++;
       if (*basicvars.current!=',') break;       /* Escape from loop if no further indexes are expected */
       basicvars.current++;
-      if (dimcount>maxdims) {               /* Too many dimensions */
+      if (dimcount>=maxdims) {              /* Too many dimensions */
         DEBUGFUNCMSGOUT;
         error(ERR_INDEXCO, vp->varname);
         return;
       }
-      if (dimcount!=maxdims) element = element*descriptor->dimsize[dimcount];
     } while (TRUE);
     if (dimcount!=maxdims) {                /* Not enough dimensions */
       DEBUGFUNCMSGOUT;
       error(ERR_INDEXCO, vp->varname);
       return;
     }
+    if ((maxdims==2 || maxdims==3) && *tp==BASTOKEN_ARRAYREF) patch_arrayref(tp, maxdims);
   }
   if (*basicvars.current!=')') {
     DEBUGFUNCMSGOUT;
@@ -329,44 +381,27 @@ static void do_elementvar(lvalue *destination) {
     return;
   }
   basicvars.current++;  /* Step past the ')' */
-  destination->typeinfo = vartype = vartype-VAR_ARRAY;  /* Clear the 'array' bit */
-  if (*basicvars.current!='?' && *basicvars.current!='!') {
-/* There is nothing after the array ref - Finish off and return home */
-/* Calculate the address of the required element */
-    switch(vartype) {
-      case VAR_INTWORD: destination->address.intaddr = descriptor->arraystart.intbase+element; break;
-      case VAR_UINT8:   destination->address.uint8addr = descriptor->arraystart.uint8base+element; break;
-      case VAR_INTLONG: destination->address.int64addr = descriptor->arraystart.int64base+element; break;
-      case VAR_FLOAT:   destination->address.floataddr = descriptor->arraystart.floatbase+element; break;
-      default: destination->address.straddr = descriptor->arraystart.stringbase+element; /* string */
-    }
-    DEBUGFUNCMSGOUT;
-    return;
-  }
+  element_lvalue(destination, vp, element);
+  DEBUGFUNCMSGOUT;
+}
+
 /*
-** The array reference is followed by an indirection operator.
-** Fetch the value of the array element. This will provide the value
-** for the left-hand side of the operator
+** 'do_fastelementvar' fills in the lvalue structure for a reference
+** to an element of a two or three dimensional array where all of the
+** indexes are simple integer variables
 */
-  switch(vartype) {
-    case VAR_INTWORD: offset = descriptor->arraystart.intbase[element]; break;
-    case VAR_UINT8:   offset = descriptor->arraystart.uint8base[element]; break;
-    case VAR_INTLONG: offset = descriptor->arraystart.int64base[element]; break;
-    case VAR_FLOAT:   offset = TONATIVEADDR(descriptor->arraystart.floatbase[element]); break;
-    default: 
-      DEBUGFUNCMSGOUT;
-      error(ERR_VARNUM);
-      return;
-  }
-/* Now deal with the indirection operator */
-  if (*basicvars.current=='?')          /* Result of operator is a single byte integer */
-    destination->typeinfo = VAR_INTBYTEPTR;
-  else {                                /* Result of operator is a four byte integer */
-    destination->typeinfo = VAR_INTWORDPTR;
+static void do_fastelementvar(lvalue *destination) {
+  variable *vp;
+  int32 element;
+
+  DEBUGFUNCMSGIN;
+  vp = GET_ADDRESS(basicvars.current, variable *);
+  element = fast_element(vp);
+  if (element<0)
+    do_elementvar(destination);
+  else {
+    element_lvalue(destination, vp, element);
   }
-  basicvars.current++;  /* Skip the operator */
-  factor();             /* Evaluate the RH operand */
-  destination->address.offset = offset+pop_anynum64();
   DEBUGFUNCMSGOUT;
 }
 
@@ -496,8 +531,8 @@ static void (*lvalue_table[256])(lvalue *) = {
   do_int64indvar, do_floatindvar, do_statindvar, bad_token,     /* 0C..0F */
   bad_token,      bad_token,      bad_token,     bad_token,     /* 10..13 */
   bad_token,      bad_token,      bad_token,     bad_token,     /* 14..17 */
-  bad_token,      bad_token,      bad_token,     bad_token,     /* 18..1B */
-  bad_token,      bad_token,      bad_token,     bad_token,     /* 1C..1F */
+  bad_token,      bad_token,      bad_token,     do_fastelementvar, /* 18..1B */
+  do_fastelementvar, bad_token,   bad_token,     bad_token,     /* 1C..1F */
   bad_token,      do_unaryind,    bad_token,     bad_token,     /* 20..23 */
   do_unaryind,    bad_token,      bad_token,     bad_syntax,    /* 24..27 */
   bad_syntax,     bad_syntax,     bad_syntax,    bad_syntax,    /* 28..2B */
@@ -2125,6 +2125,55 @@ void exec_on(void) {
   DEBUGFUNCMSGOUT;
 }
 
+/*
+** 'clear_response' discards the current contents of the string
+** array used to hold the response from 'OSCLI ... TO'
+*/
+static void clear_response(basicarray *ap) {
+  basicstring descriptor;
+  int n;
+  descriptor.stringlen = 0;
+  descriptor.stringaddr = nullstring;   /* Found in variables.c */
+  for (n=0; n<ap->arrsize; n++) {
+    free_string(ap->arraystart.stringbase[n]);
+    ap->arraystart.stringbase[n] = descriptor;
+  }
+}
+
+/*
+** 'read_response' reads the output of a command from 'respfile'
+** into the string array 'ap', one line per element starting at
+** element 1. The stream can be a file or a pipe. Once the array is
+** full the rest of the output is read and thrown away so that a
+** command writing to a pipe can run to completion. It returns the
+** number of lines read or -1 if there was an error reading them
+*/
+static int read_response(FILE *respfile, basicarray *ap) {
+  basicstring descriptor;
+  int count = 0;        /* Number of lines read */
+  while (!feof(respfile)) {     /* Read the command output */
+    int length;
+    char *p = fgets(basicvars.stringwork, MAXSTRING, respfile);
+    if (p == NIL) {     /* Either an error or EOF reached and no data read */
+      if (!ferror(respfile)) break;             /* End of file and no data read */
+      return -1;
+    }
+    if (count+1 >= ap->arrsize) continue;       /* Array is full */
+/* Remove any CRs or LFs or trailing blanks in the line and copy it to the string array */
+    if (p[0] == '\r') p++;      /* Remove possible CR at the start of the line */
+    length = strlen(p);
+    while (length>0 && (p[length-1] == '\n' || p[length-1] == '\r' || p[length-1] == ' ')) length--;
+    if (length>0 || !feof(respfile)) {  /* Don't want an empty line at the end of the array */
+      descriptor.stringlen = length;
+      descriptor.stringaddr = alloc_string(length);
+      if (length>0) memmove(descriptor.stringaddr, p, length);
+      count++;
+      ap->arraystart.stringbase[count] = descriptor;
+    }
+  }
+  return count;
+}
+
 /*
 ** 'exec_oscli' issues an OS command.
 ** The interpreter supports an extended 'OSCLI ... TO' version of
@@ -2136,9 +2185,12 @@ void exec_oscli(void) {
   lvalue response, linecount;
   boolean tofile;
   char *oscli_string;
+#ifndef OSCLI_PIPE
   char respname[FNAMESIZE];
-  int count, n;
-  FILE *respfile, *respfh;
+  FILE *respfh;
+#endif
+  int count;
+  FILE *respfile;
   basicarray *ap;
 
   DEBUGFUNCMSGIN;
@@ -2188,6 +2240,22 @@ void exec_oscli(void) {
 /*
 ** Issue the command and then read the command response
 */
+#ifdef OSCLI_PIPE
+  respfile = mos_oscli_pipe(oscli_string);
+  free(oscli_string);
+  ap = *response.address.arrayaddr;
+  clear_response(ap);
+  count = 0;
+  if (respfile != NIL) {        /* NIL = built-in command with nothing to read */
+    count = read_response(respfile, ap);
+    mos_oscli_endpipe(respfile);
+    if (count < 0) {
+      DEBUGFUNCMSGOUT;
+      error(ERR_BROKEN, __LINE__, "mainstate");
+      return;
+    }
+  }
+#else
   respfh=secure_tmpnam(respname);
   if (!respfh) {
     free(oscli_string);
@@ -2200,41 +2268,16 @@ void exec_oscli(void) {
   respfile = fopen(respname, "rb");
   if (respfile == 0) return;
   ap = *response.address.arrayaddr;
-/* Start by discarding the current contents of the array */
-  descriptor.stringlen = 0;
-  descriptor.stringaddr = nullstring;   /* Found in variables.c */
-  for (n=0; n<ap->arrsize; n++) {
-    free_string(ap->arraystart.stringbase[n]);
-    ap->arraystart.stringbase[n] = descriptor;
-  }
-  count = 0;    /* Number of lines read */
-  while (!feof(respfile) && count+1<ap->arrsize) {      /* Read the command output */
-    int length;
-    char *p = fgets(basicvars.stringwork, MAXSTRING, respfile);
-    if (p == NIL) {     /* Either an error or EOF reached and no data read */
-      if (!ferror(respfile)) break;             /* End of file and no data read */
-      fclose(respfile);
-      remove(respname);
-      DEBUGFUNCMSGOUT;
-      error(ERR_BROKEN, __LINE__, "mainstate");
-      return;
-    }
-/* Remove any CRs or LFs or trailing blanks in the line and copy it to the string array */
-    if (p == NIL) break;
-    p = basicvars.stringwork;
-    if (p[0] == '\r') p++;      /* Remove possible CR at the start of the line */
-    length = strlen(p);
-    while (length>0 && (p[length-1] == '\n' || p[length-1] == '\r' || p[length-1] == ' ')) length--;
-    if (length>0 || !feof(respfile)) {  /* Don't want an empty line at the end of the array */
-      descriptor.stringlen = length;
-      descriptor.stringaddr = alloc_string(length);
-      if (length>0) memmove(descriptor.stringaddr, p, length);
-      count++;
-      ap->arraystart.stringbase[count] = descriptor;
-    }
-  }
+  clear_response(ap);
+  count = read_response(respfile, ap);
   fclose(respfile);
   remove(respname);
+  if (count < 0) {
+    DEBUGFUNCMSGOUT;
+    error(ERR_BROKEN, __LINE__, "mainstate");
+    return;
+  }
+#endif
 /* Save the number of lines stored in the array */
   if (linecount.typeinfo != 0) store_value(linecount, count, NOSTRING);
   DEBUGFUNCMSGOUT;
@@ -3111,6 +3154,7 @@ void exec_sys(void) {
     }
   }
 /* Make the SWI call */
+  flags = 0;
   mos_sys(swino, inregs, outregs, &flags);
   for (n=0; n<MAXSYSPARMS; n++) {       /* Discard any temporary strings used */
     if (tempdesc[n].stringaddr != NIL) free_string(tempdesc[n]);
@@ -113,6 +113,19 @@
 extern threadmsg tmsg;
 #endif
 
+/*
+** On Unix-like systems commands that do not need the shell are run
+** directly with posix_spawnp(). Build with -DBRANDY_NOSPAWN to always
+** use the shell
+*/
+#if defined(TARGET_UNIX) && !defined(TARGET_MINIX) && !defined(BRANDY_NOSPAWN)
+#define USE_SPAWN
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
 #ifndef TARGET_RISCOS
 static int check_command(char *text);
 static void mos_osword(int32 areg, int64 xreg);
@@ -300,13 +313,6 @@ int32 mos_usr(int32 address) {
 #define CONTROL_MOUSE 21        /* OS_Word call number to control the mouse pointer */
 #define SELECT_MOUSE 106        /* OS_Byte call number to select a mouse pointer */
 
-/* Processor flag bits used in mos_sys() */
-
-#define OVERFLOW_FLAG 1
-#define CARRY_FLAG 2
-#define ZERO_FLAG 4
-#define NEGATIVE_FLAG 8
-
 
 int64 mos_centiseconds(void) {
   basicvars.centiseconds = clock();
@@ -1316,6 +1322,7 @@ static unsigned int cmd_parse_num(char** text) {
 #define CMD_VOICES          31
 #define CMD_POINTER         32
 #define CMD_BRANDYINFO      33
+#define CMD_FRAMEDUMP       34
 #define HELP_BASIC        1024
 #define HELP_HOST         1025
 #define HELP_MOS          1026
@@ -1396,6 +1403,7 @@ void make_cmdtab(){
   add_cmd( "ver",          CMD_VER          );
   add_cmd( "screensave",   CMD_SCREENSAVE   );
   add_cmd( "screenload",   CMD_SCREENLOAD   );
+  add_cmd( "framedump",    CMD_FRAMEDUMP    );
   add_cmd( "wintitle",     CMD_WINTITLE     );
   add_cmd( "fullscreen",   CMD_FULLSCREEN   );
   add_cmd( "newmode",      CMD_NEWMODE      );
@@ -1552,6 +1560,31 @@ static void cmd_screensave(char *command) {
   return;
 }
 
+static void cmd_framedump(char *command) {
+#ifdef USE_SDL
+  char *name, *p;
+  int32 every = 1;
+
+  while (*command == ' ') command++;    // Skip spaces
+  name = command;
+  p = command;
+  while (*p != '\0' && *p != ' ') p++;
+  if (*p == ' ') {
+    *p++ = '\0';
+    while (*p == ' ') p++;
+    if (*p != '\0') every = atoi(p);
+    if (every < 1) {
+      emulate_printf("Syntax: FrameDump (<filename> (<n>))\r\n");  // This should be an error
+      return;
+    }
+  }
+  sdl_framedump(name, every);
+#else
+  error(ERR_BADCOMMAND);
+#endif
+  return;
+}
+
 static void cmd_screenload(char *command) {
 #ifdef USE_SDL
   while (*command == ' ') command++;    // Skip spaces
@@ -1748,7 +1781,8 @@ static void cmd_help(char *command)
       emulate_printf("  NewMode    <mode> <xres> <yres> <colours> <xscale> <yscale> (<xeig> (<yeig>))\r\n");
       emulate_printf("  Refresh    (<On|Off|OnError>)\r\n");
       emulate_printf("  ScreenLoad <filename.bmp>\r\n");
-      emulate_printf("  ScreenSave <filename.bmp>\r\n");
+      emulate_printf("  ScreenSave <filename.bmp|.png|.ppm>\r\n");
+      emulate_printf("  FrameDump  (<filename> (<n>))\r\n");
 #endif /* USE_SDL */
       emulate_printf("  WinTitle   <window title>\r\n");
       break;
@@ -1800,9 +1834,16 @@ static void cmd_help(char *command)
       break;
     case CMD_SCREENSAVE:
       emulate_printf("Syntax: *ScreenSave <filename>\r\n");
-      emulate_printf("  This saves out the current screen as a .bmp (Windows bitmap) file.\r\n");
+      emulate_printf("  This saves out the current screen as a .bmp (Windows bitmap) file,\r\n");
+      emulate_printf("  or as a PNG or PPM file if the name ends in .png or .ppm.\r\n");
       emulate_printf("  This works in all screen modes, including 3, 6 and 7.\r\n");
       break;
+    case CMD_FRAMEDUMP:
+      emulate_printf("Syntax: *FrameDump (<filename> (<n>))\r\n");
+      emulate_printf("  This saves the screen as with *ScreenSave every <n>th time the display\r\n");
+      emulate_printf("  is refreshed with *Refresh. Any run of # in the name is replaced by\r\n");
+      emulate_printf("  the frame number. With no parameters, stops saving frames.\r\n");
+      break;
     case CMD_SCREENLOAD:
       emulate_printf("Syntax: *ScreenLoad <filename>\r\n  This loads a .bmp into the display window.\r\n");
       break;
@@ -2127,6 +2168,51 @@ static int check_command(char *text) {
 }
 
 
+/*
+** 'oscli_builtin' runs 'command' if it is one of the *commands
+** implemented by the interpreter itself, returning TRUE if it was
+** or FALSE if the command has to be passed to the underlying OS
+*/
+static boolean oscli_builtin(char *command) {
+  if (!basicvars.runflags.ignore_starcmd) {
+/*
+ * Check if command is one of the *commands implemented
+ * by this code.
+ */
+    int cmd = check_command(command);
+    switch(cmd){
+      case CMD_KEY:          cmd_key(command+3); return TRUE;
+      case CMD_CAT:          cmd_cat(command); return TRUE;
+      case CMD_EX:           cmd_ex(command); return TRUE;
+      case CMD_QUIT:         cmd_quit(command+4); return TRUE;
+      case CMD_HELP:         cmd_help(command+4); return TRUE;
+      case CMD_CD:           cmd_cd(command+2); return TRUE;
+      case CMD_FX:           cmd_fx(command+2); return TRUE;
+      case CMD_SHOW:         cmd_show(command+4); return TRUE;
+      case CMD_EXEC:         cmd_exec(command+4); return TRUE;
+      case CMD_SPOOL:        cmd_spool(command+5,0); return TRUE;
+      case CMD_SPOOLON:      cmd_spool(command+7,1); return TRUE;
+      case CMD_SCREENSAVE:   cmd_screensave(command+10); return TRUE;
+      case CMD_SCREENLOAD:   cmd_screenload(command+10); return TRUE;
+      case CMD_FRAMEDUMP:    cmd_framedump(command+9); return TRUE;
+      case CMD_WINTITLE:     cmd_wintitle(command+8); return TRUE;
+      case CMD_FULLSCREEN:   cmd_fullscreen(command+10); return TRUE;
+      case CMD_NEWMODE:      cmd_newmode(command+7); return TRUE;
+      case CMD_REFRESH:      cmd_refresh(command+7); return TRUE;
+      case CMD_BRANDYINFO:   cmd_brandyinfo(); return TRUE;
+
+      case CMD_LOAD:         cmd_load(command+4); return TRUE;
+      case CMD_SAVE:         cmd_save(command+4); return TRUE;
+
+      case CMD_VOLUME:       cmd_volume(command+6); return TRUE;
+      case CMD_CHANNELVOICE: cmd_channelvoice(command+12); return TRUE;
+      case CMD_VOICES:       cmd_voices(); return TRUE;
+      case CMD_POINTER:      cmd_pointer(command+7); return TRUE;
+    }
+  }
+  return FALSE;
+}
+
 /*
 ** mos_oscli issues the operating system command 'command'.
 ** 'respfile' is set to NIL if the command output is to displayed
@@ -2144,42 +2230,7 @@ void mos_oscli(char *command, char *respfile, FILE *respfh) {
   while (*command == ' ' || *command == '*') command++;
   if (*command == 0) return;                                    /* Null string */
   if (*command == (char)124 || *command == (char)221) return;   /* Comment     */
-
-  if (!basicvars.runflags.ignore_starcmd) {
-/*
- * Check if command is one of the *commands implemented
- * by this code.
- */
-    int cmd = check_command(command);
-    switch(cmd){
-      case CMD_KEY:          cmd_key(command+3); return;
-      case CMD_CAT:          cmd_cat(command); return;
-      case CMD_EX:           cmd_ex(command); return;
-      case CMD_QUIT:         cmd_quit(command+4); return;
-      case CMD_HELP:         cmd_help(command+4); return;
-      case CMD_CD:           cmd_cd(command+2); return;
-      case CMD_FX:           cmd_fx(command+2); return;
-      case CMD_SHOW:         cmd_show(command+4); return;
-      case CMD_EXEC:         cmd_exec(command+4); return;
-      case CMD_SPOOL:        cmd_spool(command+5,0); return;
-      case CMD_SPOOLON:      cmd_spool(command+7,1); return;
-      case CMD_SCREENSAVE:   cmd_screensave(command+10); return;
-      case CMD_SCREENLOAD:   cmd_screenload(command+10); return;
-      case CMD_WINTITLE:     cmd_wintitle(command+8); return;
-      case CMD_FULLSCREEN:   cmd_fullscreen(command+10); return;
-      case CMD_NEWMODE:      cmd_newmode(command+7); return;
-      case CMD_REFRESH:      cmd_refresh(command+7); return;
-      case CMD_BRANDYINFO:   cmd_brandyinfo(); return;
-
-      case CMD_LOAD:         cmd_load(command+4); return;
-      case CMD_SAVE:         cmd_save(command+4); return;
-
-      case CMD_VOLUME:       cmd_volume(command+6);return;
-      case CMD_CHANNELVOICE: cmd_channelvoice(command+12);return;
-      case CMD_VOICES:       cmd_voices();return;
-      case CMD_POINTER:      cmd_pointer(command+7);return;
-    }
-  }
+  if (oscli_builtin(command)) return;
 
   if (*command == '/') {                /* Run file, so just pass to OS     */
     command++;                          /* Step past '/'                    */
@@ -2266,6 +2317,192 @@ int ReadFromPipe(void) {
 }
 #endif /* TARGET_MINGW */
 
+#ifdef USE_SPAWN
+/*
+** Characters that need the shell to interpret them. A command that
+** contains none of these is just a list of words separated by spaces
+** and can be run without starting a shell
+*/
+#define SHELLCHARS "|&;<>()$`\\\"'*?[#~{}!\n"
+
+static pid_t pipepid;   /* Process writing to the pipe from mos_oscli_pipe() */
+
+/*
+** Commands built in to the shell. Some systems also have programs with
+** these names, but they cannot do what the built-in versions do, so
+** these are always run by the shell
+*/
+static const char *shellbuiltins[] = {
+  ".", ":", "alias", "bg", "break", "cd", "command", "continue", "eval",
+  "exec", "exit", "export", "fc", "fg", "getopts", "hash", "jobs", "local",
+  "read", "readonly", "return", "set", "shift", "source", "times", "trap",
+  "type", "ulimit", "umask", "unalias", "unset", "wait", NIL
+};
+
+/*
+** 'find_program' returns TRUE if 'name' is a program that posix_spawnp()
+** can run, searching the directories in PATH if the name contains no
+** '/'. Checking this first means that commands that cannot be found are
+** always left to the shell to report, without depending on how the
+** C library reports a failed posix_spawnp()
+*/
+static boolean find_program(char *name) {
+  char *path, *dir, *end, *full;
+  boolean found = FALSE;
+  size_t dirlen;
+
+  if (strchr(name, '/') != NIL) return access(name, X_OK) == 0;
+  path = getenv("PATH");
+  if (path == NIL) path = "/bin:/usr/bin";
+  full = malloc(strlen(path)+strlen(name)+3);
+  if (full == NIL) return FALSE;
+  for (dir = path; !found; dir = end+1) {
+    end = strchr(dir, ':');
+    dirlen = end == NIL ? strlen(dir) : (size_t)(end-dir);
+    if (dirlen == 0)            /* An empty entry is the current directory */
+      strcpy(full, name);
+    else
+      sprintf(full, "%.*s/%s", (int)dirlen, dir, name);
+    found = access(full, X_OK) == 0;
+    if (end == NIL) break;
+  }
+  free(full);
+  return found;
+}
+
+/*
+** 'split_command' breaks the command in 'cmdbuf' into words in place
+** and returns them as an argument vector for posix_spawnp(). It returns
+** NIL if the command contains any shell metacharacters, starts with a
+** variable assignment, is built in to the shell or cannot be found, in
+** which case it has to be run by the shell
+*/
+static char **split_command(char *cmdbuf) {
+  char **argv, *p;
+  int argc = 0, n;
+
+  if (strpbrk(cmdbuf, SHELLCHARS) != NIL) return NIL;
+  argv = malloc((strlen(cmdbuf)/2+2) * sizeof(char *));
+  if (argv == NIL) return NIL;
+  p = cmdbuf;
+  while (*p != asc_NUL) {
+    while (*p == ' ' || *p == '\t') *p++ = asc_NUL;
+    if (*p == asc_NUL) break;
+    argv[argc++] = p;
+    while (*p != asc_NUL && *p != ' ' && *p != '\t') p++;
+  }
+  argv[argc] = NIL;
+  if (argc == 0 || strchr(argv[0], '=') != NIL) {
+    free(argv);
+    return NIL;
+  }
+  for (n = 0; shellbuiltins[n] != NIL; n++) {
+    if (strcmp(argv[0], shellbuiltins[n]) == 0) {
+      free(argv);
+      return NIL;
+    }
+  }
+  if (!find_program(argv[0])) {
+    free(argv);
+    return NIL;
+  }
+  return argv;
+}
+
+/*
+** 'spawn_command' starts the command 'command' with posix_spawnp()
+** if it does not need the shell. If 'outfd' is not -1, the command's
+** stdout and stderr are redirected to it. It returns the process ID
+** of the command or -1 if the command has to be given to the shell.
+** That includes commands that cannot be found or run, so that the
+** shell can report the error
+*/
+static pid_t spawn_command(char *command, int outfd) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  sigset_t sigs;
+  char *cmdbuf, **argv;
+  pid_t pid;
+  int rc;
+
+  cmdbuf = malloc(strlen(command)+1);
+  if (cmdbuf == NIL) return -1;
+  strcpy(cmdbuf, command);
+  argv = split_command(cmdbuf);
+  if (argv == NIL) {
+    free(cmdbuf);
+    return -1;
+  }
+  posix_spawn_file_actions_init(&actions);
+  if (outfd != -1) {
+    posix_spawn_file_actions_adddup2(&actions, outfd, 1);
+    posix_spawn_file_actions_adddup2(&actions, outfd, 2);
+  }
+  posix_spawnattr_init(&attr);
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGQUIT);
+  posix_spawnattr_setsigdefault(&attr, &sigs);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+  rc = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  free(argv);
+  free(cmdbuf);
+  return rc == 0 ? pid : -1;
+}
+
+/*
+** 'wait_command' waits for the command started by spawn_command() to
+** finish and returns its status in the same form as system(). As with
+** system(), SIGINT and SIGQUIT are ignored while the command runs
+*/
+static int wait_command(pid_t pid) {
+  void (*oldint)(int), (*oldquit)(int);
+  int status;
+
+  oldint = signal(SIGINT, SIG_IGN);
+  oldquit = signal(SIGQUIT, SIG_IGN);
+  while (waitpid(pid, &status, 0) == -1) {
+    if (errno != EINTR) {
+      status = -1;
+      break;
+    }
+  }
+  (void) signal(SIGINT, oldint);
+  (void) signal(SIGQUIT, oldquit);
+  return status;
+}
+
+/*
+** 'spawn_pipe' starts the command 'command' with its output going to a
+** pipe and returns a stream for reading the other end of the pipe. The
+** process ID of the command is stored at 'pid'. It returns NIL if the
+** command has to be run by the shell
+*/
+static FILE *spawn_pipe(char *command, pid_t *pid) {
+  int fds[2];
+  FILE *sout;
+
+  if (pipe(fds) == -1) return NIL;
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  *pid = spawn_command(command, fds[1]);
+  close(fds[1]);
+  if (*pid == -1) {
+    close(fds[0]);
+    return NIL;
+  }
+  sout = fdopen(fds[0], "r");
+  if (sout == NIL) {            /* Should not happen, but do not leave the command hanging */
+    close(fds[0]);
+    wait_command(*pid);
+    error(ERR_CMDFAIL);
+  }
+  return sout;
+}
+#endif /* USE_SPAWN */
+
 static void native_oscli(char *command, char *respfile, FILE *respfh) {
   int clen;
 #ifndef TARGET_DJGPP
@@ -2277,6 +2514,9 @@ static void native_oscli(char *command, char *respfile, FILE *respfh) {
   char buf;
 #endif
 #endif
+#ifdef USE_SPAWN
+  pid_t pid;
+#endif
 #if defined(TARGET_MINGW) && defined(USE_SDL)
   int getChar;
   SECURITY_ATTRIBUTES saAttr;
@@ -2325,20 +2565,40 @@ static void native_oscli(char *command, char *respfile, FILE *respfh) {
 */
   if (respfile == NIL) {                /* Command output goes to normal place */
 #ifdef USE_SDL
-    STRLCAT(cmdbuf, " 2>&1", clen);
-    sout = popen(cmdbuf, "r");
-    if (sout == NULL) {
-      error(ERR_CMDFAIL);
-      return;
+#ifdef USE_SPAWN
+    sout = spawn_pipe(cmdbuf, &pid);
+    if (sout == NIL) {
+#endif
+      STRLCAT(cmdbuf, " 2>&1", clen);
+      sout = popen(cmdbuf, "r");
+      if (sout == NULL) {
+        error(ERR_CMDFAIL);
+        return;
+      }
+#ifdef USE_SPAWN
+      pid = -1;
     }
+#endif
     while (fread(&buf, 1, 1, sout) > 0) {
       if (buf == '\n') emulate_vdu('\r');
       emulate_vdu(buf);
     }
+#ifdef USE_SPAWN
+    if (pid != -1) {
+      fclose(sout);
+      wait_command(pid);
+    } else
+#endif
     pclose(sout);
 #else
     fflush(stdout);                     /* Make sure everything has been output */
     fflush(stderr);
+#ifdef USE_SPAWN
+    pid = spawn_command(cmdbuf, -1);
+    if (pid != -1)
+      basicvars.retcode = wait_command(pid);
+    else
+#endif
     basicvars.retcode = system(cmdbuf);
     find_cursor();                      /* Figure out where the cursor has gone to */
     if (basicvars.retcode < 0) {
@@ -2359,7 +2619,7 @@ static void native_oscli(char *command, char *respfile, FILE *respfh) {
 #if !defined(USE_SDL) && !defined(TARGET_RISCOS)
       echo_off();
 #endif
-      while (fgets(pipebuf, sizeof(pipebuf)-1, sout)) {
+      while (fgets(pipebuf, 4096, sout)) {
         fprintf(respfh, "%s", pipebuf);
       }
 #if !defined(USE_SDL) && !defined(TARGET_RISCOS)
@@ -2430,7 +2690,7 @@ static void native_oscli(char *command, char *respfile, FILE *respfh) {
 #if !defined(USE_SDL) && !defined(TARGET_RISCOS)
       echo_off();
 #endif
-      while (fgets(pipebuf, sizeof(pipebuf)-1, sout)) {
+      while (fgets(pipebuf, 4096, sout)) {
         fprintf(respfh, "%s", pipebuf);
       }
 #if !defined(USE_SDL) && !defined(TARGET_RISCOS)
@@ -2447,6 +2707,92 @@ static void native_oscli(char *command, char *respfile, FILE *respfh) {
   free(cmdbufbase);
 }
 
+#ifdef OSCLI_PIPE
+static FILE *pipestream;        /* Pipe opened by mos_oscli_pipe() that has not been closed yet */
+
+/*
+** mos_oscli_pipe issues the operating system command 'command'
+** with both stdout and stderr connected to a pipe and returns the
+** stream from which the command's response can be read. This is
+** used by 'OSCLI ... TO' so that the output goes straight into the
+** string array without passing through a temporary file. The
+** caller must finish with mos_oscli_endpipe(). *commands handled
+** by the interpreter itself are run in the normal way and NIL is
+** returned as they have nothing to send down the pipe
+*/
+FILE *mos_oscli_pipe(char *command) {
+  char *cmdbuf;
+  FILE *sout;
+  size_t clen;
+
+  while (*command == ' ' || *command == '*') command++;
+  if (*command == 0) return NIL;                                /* Null string */
+  if (*command == (char)124 || *command == (char)221) return NIL;       /* Comment */
+  if (oscli_builtin(command)) return NIL;
+  if (*command == '/') {                /* Run file, so just pass to OS     */
+    command++;                          /* Step past '/'                    */
+    while (*command == ' ') command++;  /* And skip any more leading spaces */
+  }
+  fflush(stdout);                       /* Make sure everything has been output */
+  fflush(stderr);
+#ifdef USE_SPAWN
+  sout = spawn_pipe(command, &pipepid);
+  if (sout != NIL) {
+#if !defined(USE_SDL)
+    echo_off();
+#endif
+    pipestream = sout;
+    return sout;
+  }
+  pipepid = 0;
+#endif
+  clen = strlen(command) + 8;
+  cmdbuf = malloc(clen);
+  if (cmdbuf == NIL) error(ERR_OSFULL, __LINE__, "mos");
+  STRLCPY(cmdbuf, command, clen);
+  STRLCAT(cmdbuf, " 2>&1", clen);
+  sout = popen(cmdbuf, "r");
+  free(cmdbuf);
+  if (sout == NIL) error(ERR_CMDFAIL);
+#if !defined(USE_SDL)
+  echo_off();
+#endif
+  pipestream = sout;
+  return sout;
+}
+
+/*
+** mos_oscli_endpipe closes the pipe opened by mos_oscli_pipe,
+** waiting for the command to finish and saving its return code
+*/
+void mos_oscli_endpipe(FILE *sout) {
+  pipestream = NIL;
+#if !defined(USE_SDL)
+  echo_on();
+#endif
+#ifdef USE_SPAWN
+  if (pipepid > 0) {
+    fclose(sout);
+    basicvars.retcode = wait_command(pipepid);
+    pipepid = 0;
+    return;
+  }
+#endif
+  basicvars.retcode = pclose(sout);
+}
+
+/*
+** mos_oscli_abandonpipe is called when an error occurs to close the
+** pipe from mos_oscli_pipe if the error happened while the response
+** was being read. Closing the pipe first means that a command that
+** is still writing to it is stopped by SIGPIPE rather than left
+** waiting for its output to be read
+*/
+void mos_oscli_abandonpipe(void) {
+  if (pipestream != NIL) mos_oscli_endpipe(pipestream);
+}
+#endif /* OSCLI_PIPE */
+
 
 void mos_getswiname(size_t swino, size_t namebuf, size_t buflen, int32 inxflag) {
   int32 ptr;
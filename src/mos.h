@@ -27,7 +27,20 @@
 
 #include "common.h"
 
+/* Processor flag bits returned by mos_sys() */
+
+#define OVERFLOW_FLAG 1
+#define CARRY_FLAG 2
+#define ZERO_FLAG 4
+#define NEGATIVE_FLAG 8
+
 extern void  mos_oscli(char *, char *, FILE *);
+#if defined(TARGET_MACOSX) | defined(TARGET_UNIX) | defined(TARGET_AMIGA) | defined(TARGET_MINGW)
+#define OSCLI_PIPE              /* 'OSCLI ... TO' reads the response through a pipe */
+extern FILE  *mos_oscli_pipe(char *);
+extern void  mos_oscli_endpipe(FILE *);
+extern void  mos_oscli_abandonpipe(void);
+#endif
 extern int32 mos_adval(int32);
 extern void  mos_sound_on(void);
 extern void  mos_sound_off(void);
@@ -43,6 +43,8 @@
 #include "screen.h"
 #include "keyboard.h"
 #include "miscprocs.h"
+#include "fileio.h"
+#include "net.h"
 #ifdef USE_SDL
 #include "SDL.h"
 #include "SDL_syswm.h"
@@ -420,6 +422,35 @@ void mos_sys_ext(size_t swino, sysparm inregs[], size_t outregs[], int32 xflag,
           return;
       }
       break;
+    case SWI_OS_GBPB: /* Only the block read and write reason codes are supported */
+      outregs[0]=inregs[0].i;outregs[1]=inregs[1].i;
+      outregs[2]=inregs[2].i;outregs[3]=inregs[3].i;
+      outregs[4]=inregs[4].i;
+      pointer = (char *)(size_t)inregs[2].i;
+#ifdef USE_SDL
+      /* Mode 7 screen memory */
+      pointer = (char *)m7offset((size_t)pointer);
+#endif
+      switch(inregs[0].i) {
+        case 1: case 2:         /* Write bytes to file, at R4 or at current PTR */
+          if (inregs[0].i==1) fileio_setptr(inregs[1].i, inregs[4].i);
+          fileio_putblock(inregs[1].i, (byte *)pointer, inregs[3].i);
+          outregs[2]+=inregs[3].i;
+          outregs[3]=0;
+          if (!fileio_isnetwork(inregs[1].i)) outregs[4]=fileio_getptr(inregs[1].i);   /* Network handles have no pointer */
+          break;
+        case 3: case 4:         /* Read bytes from file, at R4 or at current PTR */
+          if (inregs[0].i==3) fileio_setptr(inregs[1].i, inregs[4].i);
+          i=fileio_getblock(inregs[1].i, (byte *)pointer, inregs[3].i);
+          outregs[2]+=i;
+          outregs[3]=inregs[3].i-i;
+          if (!fileio_isnetwork(inregs[1].i)) outregs[4]=fileio_getptr(inregs[1].i);   /* Network handles have no pointer */
+          if (outregs[3]!=0) *flags|=CARRY_FLAG;       /* Not all bytes could be read */
+          break;
+        default: /* No-op, not supported */
+          break;
+      }
+      break;
     case SWI_OS_ReadLine:
 // RISC OS method is to tweek entry parameters then drop into ReadLine32
 // R0=b31-b28=flags, b27-b0=address
@@ -826,6 +857,118 @@ void mos_sys_ext(size_t swino, sysparm inregs[], size_t outregs[], int32 xflag,
     case SWI_Brandy_AllowLowercase:
       matrixflags.lowercasekeywords = inregs[0].i;
       break;
+    case SWI_Brandy_NetAccept:
+#ifdef NONET
+      error(ERR_NET_NOTSUPP);
+      return;
+#else
+      outregs[0]=fileio_netaccept(inregs[0].i);
+#endif
+      break;
+    case SWI_Brandy_NetWait:
+#ifdef NONET
+      error(ERR_NET_NOTSUPP);
+      return;
+#else
+      outregs[0]=brandynet_wait((int32 *)(size_t)inregs[1].i, inregs[2].i, inregs[0].i);
+#endif
+      break;
+    case SWI_Brandy_NetFlush:
+#ifdef NONET
+      error(ERR_NET_NOTSUPP);
+      return;
+#else
+      fileio_netflush(inregs[0].i);
+#endif
+      break;
+    case SWI_Brandy_NetOptions:
+#ifdef NONET
+      error(ERR_NET_NOTSUPP);
+      return;
+#else
+      outregs[0]=fileio_netoptions(inregs[0].i, inregs[1].i);
+#endif
+      break;
+    case SWI_Brandy_NetConnect:
+#ifdef NONET
+      error(ERR_NET_NOTSUPP);
+      return;
+#else
+      outregs[0]=fileio_netconnect((char *)(size_t)inregs[0].i);
+#endif
+      break;
+    case SWI_Brandy_NetStatus:
+#ifdef NONET
+      error(ERR_NET_NOTSUPP);
+      return;
+#else
+      outregs[0]=fileio_netstatus(inregs[0].i);
+#endif
+      break;
+    case SWI_Brandy_NetShutdown:
+#ifdef NONET
+      error(ERR_NET_NOTSUPP);
+      return;
+#else
+      fileio_netshutdown(inregs[0].i);
+#endif
+      break;
+    case SWI_Brandy_SpriteLoad:
+#ifdef USE_SDL
+      outregs[0]=sdl_spriteload((char *)(size_t)inregs[0].i);
+#else
+      error(ERR_SWINUMNOTKNOWN, swino);
+#endif
+      break;
+    case SWI_Brandy_SpriteGrab:
+#ifdef USE_SDL
+      outregs[0]=sdl_spritegrab(inregs[0].i, inregs[1].i, inregs[2].i, inregs[3].i);
+#else
+      error(ERR_SWINUMNOTKNOWN, swino);
+#endif
+      break;
+    case SWI_Brandy_SpritePlot:
+#ifdef USE_SDL
+      sdl_spriteplot(inregs[0].i, inregs[1].i, inregs[2].i, inregs[3].i, inregs[4].i, inregs[5].i, inregs[6].i);
+#else
+      error(ERR_SWINUMNOTKNOWN, swino);
+#endif
+      break;
+    case SWI_Brandy_SpriteInfo:
+#ifdef USE_SDL
+      {
+        int32 width, height;
+        boolean hasalpha;
+        sdl_spriteinfo(inregs[0].i, &width, &height, &hasalpha);
+        outregs[0]=width;
+        outregs[1]=height;
+        outregs[2]=hasalpha ? 1 : 0;
+      }
+#else
+      error(ERR_SWINUMNOTKNOWN, swino);
+#endif
+      break;
+    case SWI_Brandy_SpriteFree:
+#ifdef USE_SDL
+      sdl_spritefree(inregs[0].i);
+#else
+      error(ERR_SWINUMNOTKNOWN, swino);
+#endif
+      break;
+    case SWI_Brandy_FrameRate:
+#ifdef USE_SDL
+      outregs[0]=sdl_framerate(inregs[0].i);
+#else
+      error(ERR_SWINUMNOTKNOWN, swino);
+#endif
+      break;
+    case SWI_Brandy_FramePresent:
+#ifdef USE_SDL
+      outregs[0]=sdl_framepresent(inregs[0].i);
+#else
+      error(ERR_SWINUMNOTKNOWN, swino);
+#endif
+      break;
 // Raspberry Pi GPIO stuff below
     case SWI_RaspberryPi_GPIOInfo:
       outregs[0]=matrixflags.gpio; outregs[1]=(size_t)matrixflags.gpiomem;
@@ -45,6 +45,7 @@ typedef struct {
 #define SWI_OS_Byte                           0x06
 #define SWI_OS_Word                           0x07
 #define SWI_OS_File                           0x08
+#define SWI_OS_GBPB                           0x0C
 #define SWI_OS_ReadLine                       0x0E
 #define SWI_OS_GetEnv                         0x10
 #define SWI_OS_UpdateMEMC                     0x1A
@@ -133,6 +134,20 @@ typedef struct {
 #define SWI_Brandy_TranslateFNames            0x140017
 #define SWI_Brandy_MemSet                     0x140018
 #define SWI_Brandy_AllowLowercase             0x140019
+#define SWI_Brandy_NetAccept                  0x14001A
+#define SWI_Brandy_NetWait                    0x14001B
+#define SWI_Brandy_NetFlush                   0x14001C
+#define SWI_Brandy_NetOptions                 0x14001D
+#define SWI_Brandy_NetConnect                 0x14001E
+#define SWI_Brandy_NetStatus                  0x14001F
+#define SWI_Brandy_NetShutdown                0x140020
+#define SWI_Brandy_SpriteLoad                 0x140021
+#define SWI_Brandy_SpriteGrab                 0x140022
+#define SWI_Brandy_SpritePlot                 0x140023
+#define SWI_Brandy_SpriteInfo                 0x140024
+#define SWI_Brandy_SpriteFree                 0x140025
+#define SWI_Brandy_FrameRate                  0x140026
+#define SWI_Brandy_FramePresent               0x140027
 
 #define SWI_RaspberryPi_GPIOInfo                  0x140100
 #define SWI_RaspberryPi_GetGPIOPortMode           0x140101
@@ -151,6 +166,7 @@ static switable swilist[] = {
   {SWI_OS_Byte,                               "OS_Byte"},
   {SWI_OS_Word,                               "OS_Word"},
   {SWI_OS_File,                               "OS_File"},
+  {SWI_OS_GBPB,                               "OS_GBPB"},
   {SWI_OS_ReadLine,                           "OS_ReadLine"},
   {SWI_OS_GetEnv,                             "OS_GetEnv"},
   {SWI_OS_UpdateMEMC,                         "OS_UpdateMEMC"}, /* Recognised, does nothing */
@@ -236,6 +252,20 @@ static switable swilist[] = {
   {SWI_Brandy_TranslateFNames,                "Brandy_TranslateFNames"},
   {SWI_Brandy_MemSet,                         "Brandy_MemSet"},
   {SWI_Brandy_AllowLowercase,                 "Brandy_AllowLowercase"},
+  {SWI_Brandy_NetAccept,                      "Brandy_NetAccept"},
+  {SWI_Brandy_NetWait,                        "Brandy_NetWait"},
+  {SWI_Brandy_NetFlush,                       "Brandy_NetFlush"},
+  {SWI_Brandy_NetOptions,                     "Brandy_NetOptions"},
+  {SWI_Brandy_NetConnect,                     "Brandy_NetConnect"},
+  {SWI_Brandy_NetStatus,                      "Brandy_NetStatus"},
+  {SWI_Brandy_NetShutdown,                    "Brandy_NetShutdown"},
+  {SWI_Brandy_SpriteLoad,                     "Brandy_SpriteLoad"},
+  {SWI_Brandy_SpriteGrab,                     "Brandy_SpriteGrab"},
+  {SWI_Brandy_SpritePlot,                     "Brandy_SpritePlot"},
+  {SWI_Brandy_SpriteInfo,                     "Brandy_SpriteInfo"},
+  {SWI_Brandy_SpriteFree,                     "Brandy_SpriteFree"},
+  {SWI_Brandy_FrameRate,                      "Brandy_FrameRate"},
+  {SWI_Brandy_FramePresent,                   "Brandy_FramePresent"},
 
   {SWI_RaspberryPi_GPIOInfo,                  "RaspberryPi_GPIOInfo"},
   {SWI_RaspberryPi_GetGPIOPortMode,           "RaspberryPi_GetGPIOPortMode"},
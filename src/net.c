@@ -32,11 +32,22 @@
 #else
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <netdb.h>
 #endif
 #include <sys/types.h>
 #include <errno.h>
+#if defined(TARGET_LINUX)
+#include <sys/epoll.h>
+#include <poll.h>
+#define USE_EPOLL
+#elif defined(TARGET_UNIX) && !defined(TARGET_MINIX)
+#include <poll.h>
+#define USE_POLL
+#elif !defined(TARGET_MINGW)
+#include <sys/time.h>
+#endif
 #ifdef TARGET_RISCOS
 #include <ctype.h>
 #ifdef __TARGET_SCL__
@@ -59,8 +70,34 @@
 #endif
 #endif /* TARGET_MINIX */
 
+#if !defined(TARGET_RISCOS) && !defined(MINIX_OLDNET)
+#include <pthread.h>
+#define USE_CONNECTTHREAD
+#define NET_UDP
+#ifdef TARGET_UNIX
+#include <sys/un.h>
+#define NET_UNIX
+#endif
+#if defined(TARGET_UNIX) && !defined(TARGET_MINIX)
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+#define NET_PIPE
+extern char **environ;
+#endif
+#if defined(USE_EPOLL) || defined(USE_POLL)
+#define USE_WAKEUP
+#endif
+#endif
+
 #define MAXNETRCVLEN 65536
-#define MAXNETSOCKETS 4
+#define MAXNETSNDLEN 16384
+#define MAXDGRAMLEN 65507       /* Largest UDP datagram that can be sent */
+
+#define DATAGRAM_CONNECTED 1    /* UDP socket that talks to one host */
+#define DATAGRAM_BOUND 2        /* UDP socket that receives on a port from any host */
+#define INITSOCKETS 4           /* Initial size of the socket table */
+#define WAITSLICE 10            /* Longest time in centiseconds brandynet_wait() sleeps between checks for Escape */
 
 #ifdef TARGET_RISCOS
 #ifdef __TARGET_SCL__
@@ -68,13 +105,64 @@ extern int close(int);
 #endif
 #endif
 
-#ifndef NONET
-static int netsockets[MAXNETSOCKETS];
-static char netbuffer[MAXNETSOCKETS][MAXNETRCVLEN + 1];
-static int bufptr[MAXNETSOCKETS];
-static int bufendptr[MAXNETSOCKETS];
-#endif /* NONET */
-static int neteof[MAXNETSOCKETS];
+/* States of a socket as returned by brandynet_status() */
+#define NETSTATE_CONNECTED 0    /* Connected, or a listening socket */
+#define NETSTATE_CONNECTING 1   /* Connection is being made in the background */
+#define NETSTATE_REFUSED -1     /* Connection could not be made */
+#define NETSTATE_NOTFOUND -2    /* Host name could not be found */
+
+/* Details of a connection being made by connect_thread() */
+typedef struct {
+  char *dest;                   /* Host name and port to connect to */
+  char type;                    /* Address family, '0', '4' or '6' */
+  int socket;                   /* The connected socket, or -1 if the connection failed */
+  int failure;                  /* Error to report if the connection failed */
+  int done;                     /* TRUE once the thread has finished */
+  int abandoned;                /* TRUE if the handle was closed before the thread finished */
+} connectjob;
+
+/*
+** The socket table is extended as needed, so the number of sockets that
+** can be open at once is only limited by the number of file handles.
+** Receive buffers are only allocated when a socket is first read from.
+*/
+typedef struct {
+  int socket;                   /* Socket descriptor. Zero means the entry is free */
+  int eof;                      /* TRUE if the connection has been closed at the other end */
+  int listening;                /* TRUE if this is a listening socket */
+  int owner;                    /* Basic file handle the socket belongs to */
+  int ready;                    /* Used by brandynet_wait() to avoid listing a socket twice */
+  int bufptr;                   /* Index of next byte to read in 'buffer' */
+  int bufendptr;                /* Index of end of data in 'buffer' */
+  char *buffer;                 /* Receive buffer */
+  int outlen;                   /* Number of bytes waiting to be sent in 'outbuf' */
+  int options;                  /* NETOPT_xxx options set for the socket */
+  char *outbuf;                 /* Send buffer */
+  int state;                    /* NETSTATE_xxx state of the connection */
+  connectjob *job;              /* Background connection if 'state' is NETSTATE_CONNECTING */
+  int datagram;                 /* Zero for a TCP socket, otherwise DATAGRAM_xxx for UDP */
+  char *path;                   /* Name of the socket file of a listening Unix domain socket */
+#ifdef NET_PIPE
+  pid_t pid;                    /* Process ID of the command on a "pipe:" handle, else zero */
+#endif
+#ifdef NET_UDP
+  socklen_t peerlen;            /* Length of 'peer' or zero if nothing has been received */
+  struct sockaddr_storage peer; /* Where the last datagram on a bound UDP socket came from */
+#endif
+} netsocket;
+
+static netsocket *netsockets;   /* The socket table */
+static int netcount;            /* Number of entries in the socket table */
+#ifdef USE_EPOLL
+static int epollfd = -1;        /* epoll instance that all sockets are registered with */
+#endif
+#ifdef USE_CONNECTTHREAD
+static pthread_mutex_t netlock = PTHREAD_MUTEX_INITIALIZER;   /* Protects the 'connectjob' structures */
+#endif
+#ifdef USE_WAKEUP
+static int wakeup[2] = {-1, -1};        /* Pipe written to when a background connection finishes */
+#define WAKEUP_EVENT 0xFFFFFFFFu        /* epoll event data for the wakeup pipe */
+#endif
 
 #ifdef __TARGET_SCL__
 /* SharedCLibrary is missing inet_aton(). Here'a an implementation */
@@ -142,9 +230,23 @@ in_addr_t inet_aton(const char *cp, struct in_addr *addr) {
 }
 #endif /* __TARGET_SCL__ */
 
-/* This function only called on startup, cleans the buffer and socket stores */
+/* Switch a socket to non-blocking mode */
+static void set_nonblocking(int mysocket) {
+#if defined(__TARGET_SCL__)
+  /* SharedCLibrary doesn't support fcntl */
+  unsigned long opt=1;
+  socketioctl(mysocket, FIONBIO, &opt);
+#elif defined(TARGET_MINGW)
+  unsigned long opt=1;
+  ioctlsocket(mysocket, FIONBIO, &opt);
+#else
+  int flags = fcntl(mysocket, F_GETFL, 0);
+  fcntl(mysocket, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+/* This function only called on startup, sets up the socket table */
 void brandynet_init() {
-  int n;
 #ifdef TARGET_MINGW
   WSADATA wsaData;
 #endif
@@ -156,10 +258,30 @@ void brandynet_init() {
 
   DEBUGFUNCMSGIN;
   matrixflags.networking = 1;
-  for (n=0; n<MAXNETSOCKETS; n++) {
-    netsockets[n]=bufptr[n]=bufendptr[n]=neteof[n]=0;
-    memset(netbuffer, 0, (MAXNETSOCKETS * (MAXNETRCVLEN+1)));
+  netsockets = calloc(INITSOCKETS, sizeof(netsocket));
+  if (netsockets == NIL) {
+    matrixflags.networking = 0;
+    return;
   }
+  netcount = INITSOCKETS;
+#ifdef USE_EPOLL
+  epollfd = epoll_create(INITSOCKETS);
+  if (epollfd == -1) matrixflags.networking = 0;
+#endif
+#ifdef USE_WAKEUP
+  if (pipe(wakeup) == 0) {
+    set_nonblocking(wakeup[0]);
+#ifdef USE_EPOLL
+    {
+      struct epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.u32 = WAKEUP_EVENT;
+      epoll_ctl(epollfd, EPOLL_CTL_ADD, wakeup[0], &event);
+    }
+#endif
+  }
+#endif
 #ifdef TARGET_MINGW
   if(WSAStartup(MAKEWORD(2,2), &wsaData)) matrixflags.networking=0;
 #endif
@@ -184,19 +306,64 @@ void brandynet_init() {
   DEBUGFUNCMSGOUT;
 }
 
-int brandynet_connect(char *dest, char type, int reporterrors) {
+/* This function returns the index of an unused entry in the socket table,
+ * doubling the size of the table if they are all in use. It returns -1
+ * if the table cannot be extended.
+ */
+static int find_socket(int reporterrors) {
+  int n;
+  netsocket *newtable;
+
+  for (n=0; n<netcount; n++) {
+    if (!netsockets[n].socket) return(n);
+  }
+  newtable = realloc(netsockets, 2 * netcount * sizeof(netsocket));
+  if (newtable == NIL) {
+    if (reporterrors) error(ERR_NET_MAXSOCKETS);
+    return(-1);
+  }
+  memset(newtable + netcount, 0, netcount * sizeof(netsocket));
+  netsockets = newtable;
+  n = netcount;
+  netcount = 2 * netcount;
+  return(n);
+}
+
+/* This function switches socket 'mysocket' to non-blocking mode and
+ * registers it with epoll, where that is used, as entry 'n' of the table.
+ */
+static void watch_socket(int n, int mysocket) {
+#ifdef USE_EPOLL
+  struct epoll_event event;
+#endif
+
+  set_nonblocking(mysocket);
+  netsockets[n].socket = mysocket;
+#ifdef USE_EPOLL
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u32 = n;
+  epoll_ctl(epollfd, EPOLL_CTL_ADD, mysocket, &event);
+#endif
+}
+
+/* This function fills in entry 'n' of the socket table for the newly
+ * opened socket 'mysocket'
+ */
+static void add_socket(int n, int mysocket, int listening) {
+  memset(&netsockets[n], 0, sizeof(netsocket));
+  netsockets[n].listening = listening;
+  netsockets[n].state = NETSTATE_CONNECTED;
+  watch_socket(n, mysocket);
+}
+
 #if defined(TARGET_RISCOS) | defined(MINIX_OLDNET)
+int brandynet_connect(char *dest, char type, int reporterrors) {
   char *host, *port;
   int n, mysocket, portnum, result;
-#ifndef __TARGET_SCL__
-  int flags;
-#endif
   struct sockaddr_in netdest;
   struct hostent *he = NULL;
   struct in_addr *inaddr = NULL;
-#ifdef __TARGET_SCL__
-  unsigned long opt;
-#endif
 
   DEBUGFUNCMSGIN;
   if(matrixflags.networking==0) {
@@ -204,13 +371,8 @@ int brandynet_connect(char *dest, char type, int reporterrors) {
     return(-1);
   }
 
-  for (n=0; n<MAXNETSOCKETS; n++) {
-    if (!netsockets[n]) break;
-  }
-  if (MAXNETSOCKETS == n) {
-    if (reporterrors) error(ERR_NET_MAXSOCKETS);
-    return(-1);
-  }
+  n = find_socket(reporterrors);
+  if (n == -1) return(-1);
 
   host=strdup(dest);
   port=strchr(host,':');
@@ -245,59 +407,41 @@ int brandynet_connect(char *dest, char type, int reporterrors) {
   }
   free(inaddr);                              /* Don't need this any more */
 
-#ifdef __TARGET_SCL__
-  /* SharedCLibrary doesn't support fcntl */
-  opt=1;
-  socketioctl(mysocket, FIONBIO, &opt);
-#else
-  flags = fcntl(mysocket, F_GETFL, 0);
-  fcntl(mysocket, F_SETFL, flags | O_NONBLOCK);
-#endif
-  netsockets[n] = mysocket;
+  add_socket(n, mysocket, 0);
   DEBUGFUNCMSGOUT;
   return(n);
 
+}
+
 #else /* not TARGET_RISCOS */
+/* This function resolves host name and port 'dest' and connects a socket
+ * of type 'socktype' to it, returning the socket or -1 if this fails, in which case '*failure' is
+ * set to the error to report. If 'quick' is set, the connection attempt
+ * times out after three seconds. This is also used by the thread that
+ * makes connections in the background, so it must not call error().
+ */
+static int open_connection(char *dest, char type, int socktype, int quick, int *failure) {
   char *host, *port;
-  int n, mysocket=0, ret, sockres=-1;
+  int mysocket=0, ret, sockres=-1;
   struct addrinfo hints, *addrdata, *rp;
-#ifdef TARGET_MINGW
-  unsigned long opt;
-#else
+#ifndef TARGET_MINGW
   struct timeval timeout;
-  int flags;
 #endif
 
-  if(matrixflags.networking==0) {
-    if (reporterrors) error(ERR_NET_NOTSUPP);
-    return(-1);
-  }
-
-  for (n=0; n<MAXNETSOCKETS; n++) {
-    if (!netsockets[n]) break;
-  }
-  if (MAXNETSOCKETS == n) {
-    if (reporterrors) error(ERR_NET_MAXSOCKETS);
-    return(-1);
-  }
-
   memset(&hints, 0, sizeof(hints));
   if (type == '0') hints.ai_family=AF_UNSPEC;
   else if (type == '4') hints.ai_family=AF_INET;
   else if (type == '6') hints.ai_family=AF_INET6;
-  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_socktype = socktype;
   hints.ai_flags = AI_ADDRCONFIG;
-  hints.ai_protocol = IPPROTO_TCP;
+  hints.ai_protocol = socktype == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP;
 
+  *failure = ERR_NET_NOTFOUND;
   host=strdup(dest);
-  if (host == NULL) {
-    error(ERR_NET_NOTFOUND);
-    return(-1);
-  }
+  if (host == NULL) return(-1);
   port=strchr(host,':');
   if (port == NULL) {
     free(host);
-    error(ERR_NET_NOTFOUND);
     return(-1);
   }
   port[0]='\0';
@@ -310,18 +454,17 @@ int brandynet_connect(char *dest, char type, int reporterrors) {
 #ifdef DEBUG
     if (basicvars.debug_flags.debug) fprintf(stderr, "getaddrinfo returns: %s\n", gai_strerror(ret));
 #endif
-    if (reporterrors) error(ERR_NET_NOTFOUND);
     return(-1);
   }
 
 /* Set the timeout of the socket if we're not reporting errors */
   for(rp = addrdata; rp != NULL; rp = rp->ai_next) {
-    mysocket = socket(rp->ai_family, SOCK_STREAM, 0);
+    mysocket = socket(rp->ai_family, socktype, 0);
     if (mysocket == -1) continue;
 #ifndef TARGET_MINGW
     timeout.tv_sec = 3;
     timeout.tv_usec = 0;
-    if (!reporterrors) setsockopt(mysocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (quick) setsockopt(mysocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
 #endif
     sockres=connect(mysocket, rp->ai_addr, rp->ai_addrlen);
     if (!sockres)
@@ -332,27 +475,480 @@ int brandynet_connect(char *dest, char type, int reporterrors) {
   freeaddrinfo(addrdata);               /* Don't need this any more either */
 
   if (sockres) {
-    if (reporterrors) error(ERR_NET_CONNREFUSED);
+    *failure = ERR_NET_CONNREFUSED;
     return(-1);
   }
+  return(mysocket);
+}
 
-#ifdef TARGET_MINGW
-  opt=1;
-  ioctlsocket(mysocket, FIONBIO, &opt);
+int brandynet_connect(char *dest, char type, int reporterrors) {
+  int n, mysocket, failure;
+
+  DEBUGFUNCMSGIN;
+  if(matrixflags.networking==0) {
+    if (reporterrors) error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+
+  n = find_socket(reporterrors);
+  if (n == -1) return(-1);
+
+  mysocket = open_connection(dest, type, SOCK_STREAM, !reporterrors, &failure);
+  if (mysocket == -1) {
+    if (reporterrors) error(failure);
+    return(-1);
+  }
+
+  add_socket(n, mysocket, 0);
+  DEBUGFUNCMSGOUT;
+  return(n);
+}
+
+/* This function creates a socket of type 'socktype' bound to port 'port'
+ * on all of the machine's addresses, listening for connections if it is
+ * a stream socket. It returns the socket, or -1 if this fails, in which
+ * case '*failure' is set to the error to report.
+ */
+static int bind_port(char *port, char type, int socktype, int *failure) {
+  int mysocket=0, ret, sockres=-1, on = 1;
+  struct addrinfo hints, *addrdata, *rp;
+
+  memset(&hints, 0, sizeof(hints));
+  if (type == '0') hints.ai_family=AF_UNSPEC;
+  else if (type == '4') hints.ai_family=AF_INET;
+  else if (type == '6') hints.ai_family=AF_INET6;
+  hints.ai_socktype = socktype;
+  hints.ai_flags = AI_PASSIVE;
+  hints.ai_protocol = socktype == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP;
+
+  ret=getaddrinfo(NULL, port, &hints, &addrdata);
+  if(ret) {
+    *failure = ERR_NET_NOTFOUND;
+    return(-1);
+  }
+  for(rp = addrdata; rp != NULL; rp = rp->ai_next) {
+    mysocket = socket(rp->ai_family, socktype, 0);
+    if (mysocket == -1) continue;
+    setsockopt(mysocket, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on));
+    sockres=bind(mysocket, rp->ai_addr, rp->ai_addrlen);
+    if (!sockres && socktype == SOCK_STREAM) sockres=listen(mysocket, SOMAXCONN);
+    if (!sockres)
+      break; /* success! */
+    close(mysocket);
+  }
+  freeaddrinfo(addrdata);
+
+  if (sockres) {
+    *failure = ERR_NET_INUSE;
+    return(-1);
+  }
+  return(mysocket);
+}
+#endif /* not RISCOS */
+
+/* This function opens a UDP socket. If 'dest' is of the form "host:port",
+ * datagrams are sent to that host and port and only datagrams from there
+ * are received. If it is ":port", the socket receives datagrams sent to
+ * that port from anywhere, and replies go to wherever the last datagram
+ * came from.
+ */
+int brandynet_udp(char *dest, char type, int reporterrors) {
+#ifdef NET_UDP
+  int n, mysocket, failure;
+
+  DEBUGFUNCMSGIN;
+  if(matrixflags.networking==0) {
+    if (reporterrors) error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+  n = find_socket(reporterrors);
+  if (n == -1) return(-1);
+
+  if (dest[0] == ':')
+    mysocket = bind_port(dest+1, type, SOCK_DGRAM, &failure);
+  else
+    mysocket = open_connection(dest, type, SOCK_DGRAM, 0, &failure);
+  if (mysocket == -1) {
+    if (reporterrors) error(failure);
+    return(-1);
+  }
+  add_socket(n, mysocket, 0);
+  netsockets[n].datagram = dest[0] == ':' ? DATAGRAM_BOUND : DATAGRAM_CONNECTED;
+  DEBUGFUNCMSGOUT;
+  return(n);
 #else
-  flags = fcntl(mysocket, F_GETFL, 0);
-  fcntl(mysocket, F_SETFL, flags | O_NONBLOCK);
+  if (reporterrors) error(ERR_NET_NOTSUPP);
+  return(-1);
+#endif
+}
+
+#ifdef USE_CONNECTTHREAD
+/* This is the thread that makes a connection in the background for
+ * brandynet_connect_async(). If the handle has been closed by the time
+ * it finishes, it cleans up the connection itself.
+ */
+static void *connect_thread(void *data) {
+  connectjob *job = data;
+  int mysocket, failure, abandoned;
+
+  mysocket = open_connection(job->dest, job->type, SOCK_STREAM, 0, &failure);
+  pthread_mutex_lock(&netlock);
+  job->socket = mysocket;
+  job->failure = failure;
+  job->done = 1;
+  abandoned = job->abandoned;
+  pthread_mutex_unlock(&netlock);
+  if (abandoned) {
+    if (mysocket != -1) close(mysocket);
+    free(job->dest);
+    free(job);
+  }
+#ifdef USE_WAKEUP
+  else {
+    char ch = 0;
+    if (write(wakeup[1], &ch, 1) == -1) {}      /* Wake up brandynet_wait(). Nothing to be done if this fails */
+  }
+#endif
+  return(NIL);
+}
+#endif
+
+/* This function opens a Unix domain socket. If 'listening' is TRUE, it
+ * creates socket file 'path' and listens for connections on it, replacing
+ * the file if it is left over from a program that is no longer running.
+ * Otherwise it connects to the program listening on 'path'.
+ */
+int brandynet_unix(char *path, int listening, int reporterrors) {
+#ifdef NET_UNIX
+  int n, mysocket, result;
+  struct sockaddr_un netaddr;
+
+  DEBUGFUNCMSGIN;
+  if(matrixflags.networking==0) {
+    if (reporterrors) error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+  if (strlen(path) >= sizeof(netaddr.sun_path)) {
+    if (reporterrors) error(ERR_NET_NOTFOUND);
+    return(-1);
+  }
+  n = find_socket(reporterrors);
+  if (n == -1) return(-1);
+
+  memset(&netaddr, 0, sizeof(netaddr));
+  netaddr.sun_family = AF_UNIX;
+  strcpy(netaddr.sun_path, path);
+  mysocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (mysocket == -1) {
+    if (reporterrors) error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+  if (listening) {
+    result = bind(mysocket, (struct sockaddr *)&netaddr, sizeof(netaddr));
+    if (result == -1 && errno == EADDRINUSE) {
+/* See if anything is still listening on the old socket file and remove it if not */
+      int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (connect(probe, (struct sockaddr *)&netaddr, sizeof(netaddr)) == -1 && errno == ECONNREFUSED) {
+        unlink(path);
+        result = bind(mysocket, (struct sockaddr *)&netaddr, sizeof(netaddr));
+      }
+      close(probe);
+    }
+    if (result == 0) result = listen(mysocket, SOMAXCONN);
+    if (result == -1) {
+      close(mysocket);
+      if (reporterrors) error(ERR_NET_INUSE);
+      return(-1);
+    }
+  } else if (connect(mysocket, (struct sockaddr *)&netaddr, sizeof(netaddr)) == -1) {
+    close(mysocket);
+    if (reporterrors) error(errno == ENOENT ? ERR_NET_NOTFOUND : ERR_NET_CONNREFUSED);
+    return(-1);
+  }
+  add_socket(n, mysocket, listening);
+  if (listening) netsockets[n].path = strdup(path);
+  DEBUGFUNCMSGOUT;
+  return(n);
+#else
+  if (reporterrors) error(ERR_NET_NOTSUPP);
+  return(-1);
 #endif
-  netsockets[n] = mysocket;
+}
+
+/* This function runs 'command' with the shell, with its standard input
+ * and output connected to one end of a socket pair. The other end is
+ * returned as a socket so that the program can talk to the command for
+ * as long as the handle is open. The command is put in a process group
+ * of its own so that pressing Escape does not kill it as well.
+ */
+int brandynet_pipe(char *command, int reporterrors) {
+#ifdef NET_PIPE
+  int n, fds[2], result;
+  pid_t pid;
+  char *argv[4];
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+
+  DEBUGFUNCMSGIN;
+  if(matrixflags.networking==0) {
+    if (reporterrors) error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+  n = find_socket(reporterrors);
+  if (n == -1) return(-1);
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+    if (reporterrors) error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  argv[0] = "sh";
+  argv[1] = "-c";
+  argv[2] = command;
+  argv[3] = NIL;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 0);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+  result = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  if (result != 0) {
+    close(fds[0]);
+    if (reporterrors) error(ERR_CMDFAIL);
+    return(-1);
+  }
+  add_socket(n, fds[0], 0);
+  netsockets[n].pid = pid;
   DEBUGFUNCMSGOUT;
   return(n);
-#endif /* not RISCOS */
+#else
+  if (reporterrors) error(ERR_NET_NOTSUPP);
+  return(-1);
+#endif
+}
+
+/* This function starts a connection to 'dest' without waiting for it to
+ * be made, returning the index of the socket in the table. The socket is
+ * in the 'connecting' state until the host name has been looked up and the
+ * connection made by a helper thread, which brandynet_status() reports.
+ * Where threads are not available, the connection is made at once.
+ */
+int brandynet_connect_async(char *dest, char type) {
+#ifdef USE_CONNECTTHREAD
+  int n;
+  connectjob *job;
+  pthread_t thread;
+  pthread_attr_t attrs;
+
+  DEBUGFUNCMSGIN;
+  if(matrixflags.networking==0) error(ERR_NET_NOTSUPP);
+  if (strchr(dest, ':') == NIL) error(ERR_NET_NOTFOUND);
+  n = find_socket(1);
+  job = calloc(1, sizeof(connectjob));
+  if (job == NIL) error(ERR_NOROOM);
+  job->dest = strdup(dest);
+  if (job->dest == NIL) {
+    free(job);
+    error(ERR_NOROOM);
+  }
+  job->type = type;
+  pthread_attr_init(&attrs);
+  pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&thread, &attrs, &connect_thread, job)) {
+    pthread_attr_destroy(&attrs);
+    free(job->dest);
+    free(job);
+    return(brandynet_connect(dest, type, 1));   /* Could not start the thread - Connect now instead */
+  }
+  pthread_attr_destroy(&attrs);
+  memset(&netsockets[n], 0, sizeof(netsocket));
+  netsockets[n].socket = -1;                    /* Entry in use, but there is no socket yet */
+  netsockets[n].state = NETSTATE_CONNECTING;
+  netsockets[n].job = job;
+  DEBUGFUNCMSGOUT;
+  return(n);
+#else
+  return(brandynet_connect(dest, type, 1));
+#endif
 }
 
+/* This function creates a socket listening for incoming connections on
+ * port 'port' on all of the machine's addresses. Connections are picked
+ * up by brandynet_accept().
+ */
+int brandynet_listen(char *port, char type, int reporterrors) {
+#if defined(TARGET_RISCOS) | defined(MINIX_OLDNET)
+  int n, mysocket, on = 1;
+  struct sockaddr_in netaddr;
+
+  DEBUGFUNCMSGIN;
+  if(matrixflags.networking==0) {
+    if (reporterrors) error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+  n = find_socket(reporterrors);
+  if (n == -1) return(-1);
+
+  mysocket = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(mysocket, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on));
+  memset(&netaddr, 0, sizeof(netaddr));
+  netaddr.sin_family = AF_INET;
+  netaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  netaddr.sin_port = htons(atoi(port));
+  if (bind(mysocket, (struct sockaddr *)&netaddr, sizeof(netaddr)) || listen(mysocket, SOMAXCONN)) {
+    close(mysocket);
+    if (reporterrors) error(ERR_NET_INUSE);
+    return(-1);
+  }
+#else
+  int n, mysocket, failure;
+
+  DEBUGFUNCMSGIN;
+  if(matrixflags.networking==0) {
+    if (reporterrors) error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+  n = find_socket(reporterrors);
+  if (n == -1) return(-1);
+
+  mysocket = bind_port(port, type, SOCK_STREAM, &failure);
+  if (mysocket == -1) {
+    if (reporterrors) error(failure);
+    return(-1);
+  }
+#endif
+  add_socket(n, mysocket, 1);
+  DEBUGFUNCMSGOUT;
+  return(n);
+}
+
+/* This function picks up the next incoming connection on listening socket
+ * 'handle', returning its index in the socket table, or -1 if there are
+ * no connections waiting.
+ */
+int brandynet_accept(int handle) {
+  int n, mysocket;
+
+  DEBUGFUNCMSGIN;
+  if (!netsockets[handle].listening) {
+    error(ERR_NET_NOTSUPP);
+    return(-1);
+  }
+  n = find_socket(1);
+  mysocket = accept(netsockets[handle].socket, NULL, NULL);
+  if (mysocket == -1) {                 /* Nothing waiting */
+    DEBUGFUNCMSGOUT;
+    return(-1);
+  }
+  add_socket(n, mysocket, 0);
+  DEBUGFUNCMSGOUT;
+  return(n);
+}
+
+/* This function checks whether the background connection for socket
+ * 'handle' has finished and, if it has, makes the socket usable or marks
+ * the connection as failed. Any data written while the connection was
+ * being made is sent now.
+ */
+static void finish_connect(int handle) {
+#ifdef USE_CONNECTTHREAD
+  netsocket *sp = &netsockets[handle];
+  connectjob *job = sp->job;
+  int done;
+
+  if (sp->state != NETSTATE_CONNECTING) return;
+  pthread_mutex_lock(&netlock);
+  done = job->done;
+  pthread_mutex_unlock(&netlock);
+  if (!done) return;
+  sp->job = NIL;
+  if (job->socket == -1) {
+    sp->state = job->failure == ERR_NET_NOTFOUND ? NETSTATE_NOTFOUND : NETSTATE_REFUSED;
+    sp->eof = 1;
+    sp->outlen = 0;
+  } else {
+    sp->state = NETSTATE_CONNECTED;
+    watch_socket(handle, job->socket);
+    if (sp->options) net_options(handle, sp->options);
+    if (sp->outlen > 0) net_flush(handle);
+  }
+  free(job->dest);
+  free(job);
+#endif
+}
+
+/* This function returns the state of socket 'handle', one of the
+ * NETSTATE_xxx values
+ */
+int32 brandynet_status(int handle) {
+  finish_connect(handle);
+  return(netsockets[handle].state);
+}
+
+#ifdef NET_PIPE
+#define PIPESTOPWAIT 50         /* Waits of 10ms before a command still running is sent SIGTERM */
+#define PIPEKILLWAIT 100        /* Waits of 10ms before it is sent SIGKILL */
+
+/* This function waits for the command on a "pipe:" handle to finish once
+ * its end of the socket pair has been closed. A command that is still
+ * running after half a second, for example one that never finishes by
+ * itself, is sent SIGTERM, or straight away if Escape is pressed, and
+ * SIGKILL half a second after that. The signals go to the command's
+ * process group so that anything it has started is stopped as well.
+ */
+static void reap_command(pid_t pid) {
+  int waits = 0;
+
+  while (waitpid(pid, NIL, WNOHANG) == 0) {
+    if (basicvars.escape && waits < PIPESTOPWAIT) waits = PIPESTOPWAIT;
+    if (waits == PIPESTOPWAIT) kill(-pid, SIGTERM);
+    if (waits == PIPEKILLWAIT) kill(-pid, SIGKILL);
+    usleep(10000);
+    waits++;
+  }
+}
+#endif
+
 int brandynet_close(int handle) {
   DEBUGFUNCMSGIN;
-  close(netsockets[handle]);
-  netsockets[handle] = neteof[handle] = 0;
+#ifdef USE_CONNECTTHREAD
+  if (netsockets[handle].state == NETSTATE_CONNECTING) {
+    connectjob *job = netsockets[handle].job;
+    int done;
+    pthread_mutex_lock(&netlock);
+    done = job->done;
+    job->abandoned = 1;         /* If still connecting the thread tidies up when it finishes */
+    pthread_mutex_unlock(&netlock);
+    if (done) {
+      if (job->socket != -1) close(job->socket);
+      free(job->dest);
+      free(job);
+    }
+    free(netsockets[handle].outbuf);
+    memset(&netsockets[handle], 0, sizeof(netsocket));
+    DEBUGFUNCMSGOUT;
+    return(0);
+  }
+#endif
+  net_flush(handle);
+#ifdef USE_EPOLL
+  epoll_ctl(epollfd, EPOLL_CTL_DEL, netsockets[handle].socket, NIL);
+#endif
+  if (netsockets[handle].socket != -1) close(netsockets[handle].socket);
+  free(netsockets[handle].buffer);
+  free(netsockets[handle].outbuf);
+  if (netsockets[handle].path != NIL) {         /* Remove the socket file of a Unix domain socket */
+    unlink(netsockets[handle].path);
+    free(netsockets[handle].path);
+  }
+#ifdef NET_PIPE
+  if (netsockets[handle].pid != 0) reap_command(netsockets[handle].pid);
+#endif
+  memset(&netsockets[handle], 0, sizeof(netsocket));
   DEBUGFUNCMSGOUT;
   return(0);
 }
@@ -361,18 +957,239 @@ int brandynet_close(int handle) {
 #ifndef MSG_DONTWAIT
 #define MSG_DONTWAIT 0
 #endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifdef TARGET_MINGW
+#define SEND_WOULDBLOCK (WSAGetLastError() == WSAEWOULDBLOCK)
+#define SEND_REFUSED (WSAGetLastError() == WSAECONNRESET)
+#else
+#define SEND_WOULDBLOCK (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+#define SEND_REFUSED (errno == ECONNREFUSED)
+#endif
+
+/* This function waits for up to WAITSLICE centiseconds for there to be
+ * room to send more data on a socket.
+ */
+static void wait_writable(int mysocket) {
+#if defined(USE_EPOLL) || defined(USE_POLL)
+  struct pollfd fds;
+
+  fds.fd = mysocket;
+  fds.events = POLLOUT;
+  fds.revents = 0;
+  poll(&fds, 1, WAITSLICE * 10);
+#else
+  fd_set fds;
+  struct timeval timeout;
+
+  FD_ZERO(&fds);
+  FD_SET(mysocket, &fds);
+  timeout.tv_sec = 0;
+  timeout.tv_usec = WAITSLICE * 10000;
+  select(mysocket+1, NIL, &fds, NIL, &timeout);
+#endif
+}
+
+#ifdef NET_UDP
+/* This function sends the contents of the send buffer of a UDP socket as
+ * one datagram. Datagrams refused by the other end (reported when the
+ * next one is sent) are silently dropped, as UDP makes no promise that
+ * they arrive anyway. It returns 1 if the datagram could not be sent.
+ */
+static int send_datagram(netsocket *sp) {
+  int result;
+
+  if (sp->outlen == 0) return(0);
+  if (sp->datagram == DATAGRAM_BOUND && sp->peerlen == 0) {     /* Nowhere to send it yet */
+    sp->outlen = 0;
+    return(1);
+  }
+  do {
+    if (sp->datagram == DATAGRAM_CONNECTED)
+      result = send(sp->socket, sp->outbuf, sp->outlen, MSG_NOSIGNAL);
+    else
+      result = sendto(sp->socket, sp->outbuf, sp->outlen, MSG_NOSIGNAL, (struct sockaddr *)&sp->peer, sp->peerlen);
+    if (result != -1 || !SEND_WOULDBLOCK || basicvars.escape) break;
+    wait_writable(sp->socket);
+  } while (TRUE);
+  sp->outlen = 0;
+  return(result == -1 && !SEND_REFUSED);
+}
+#endif
+
+/* This function sends the contents of the socket's send buffer, waiting
+ * for the connection to accept it if need be. It returns 1 if the data
+ * could not be sent. If Escape is pressed, the data not yet sent is left
+ * in the buffer.
+ */
+int net_flush(int handle) {
+  netsocket *sp = &netsockets[handle];
+  int sent = 0, retval = 0;
+
+  DEBUGFUNCMSGIN;
+  while (sp->state == NETSTATE_CONNECTING) {
+/* Keep the data until the connection has been made unless the buffer is full */
+    if (sp->outlen < MAXNETSNDLEN || basicvars.escape) {
+      DEBUGFUNCMSGOUT;
+      return(0);
+    }
+    usleep(10000);
+    finish_connect(handle);
+  }
+  if (sp->state != NETSTATE_CONNECTED) {
+    sp->outlen = 0;
+    DEBUGFUNCMSGOUT;
+    return(1);
+  }
+#ifdef NET_UDP
+  if (sp->datagram) {
+    retval = send_datagram(sp);
+    DEBUGFUNCMSGOUT;
+    return(retval);
+  }
+#endif
+  while (sent < sp->outlen) {
+    int result = send(sp->socket, sp->outbuf + sent, sp->outlen - sent, MSG_NOSIGNAL);
+    if (result > 0) {
+      sent += result;
+    } else if (result == -1 && SEND_WOULDBLOCK && !basicvars.escape) {
+      wait_writable(sp->socket);
+    } else {
+      if (!basicvars.escape) retval = 1;        /* Connection has failed */
+      break;
+    }
+  }
+  if (retval || sent == sp->outlen) {
+    sp->outlen = 0;
+  } else {
+    memmove(sp->outbuf, sp->outbuf + sent, sp->outlen - sent);
+    sp->outlen -= sent;
+  }
+  DEBUGFUNCMSGOUT;
+  return(retval);
+}
+
+/* This function sends any data waiting in the send buffers of all sockets */
+static void net_flushall(void) {
+  int n;
+
+  for (n=0; n<netcount; n++) {
+    if (netsockets[n].socket && netsockets[n].outlen > 0) net_flush(n);
+  }
+}
+
+/* This function sends anything waiting in the send buffer of socket
+ * 'handle' and then closes the sending side of the connection, so that
+ * the other end, or the command on a "pipe:" handle, sees end of file.
+ * Data can still be read from the socket. It returns 1 if the data could
+ * not be sent.
+ */
+int brandynet_shutdown(int handle) {
+  int retval;
+
+  retval = net_flush(handle);
+  if (netsockets[handle].state == NETSTATE_CONNECTED && !netsockets[handle].listening) {
+#ifdef TARGET_MINGW
+    shutdown(netsockets[handle].socket, SD_SEND);
+#else
+    shutdown(netsockets[handle].socket, SHUT_WR);
+#endif
+  }
+  return(retval);
+}
+
+/* This function sets the options in 'options' for socket 'handle' and
+ * returns the options previously in effect. NETOPT_NODELAY and NETOPT_CORK
+ * control the TCP options of the same names (TCP_NOPUSH on the BSDs and
+ * macOS), and NETOPT_UNBUFFERED sends data as soon as it is written rather
+ * than holding it in the send buffer. If 'options' is -1 the options are
+ * just returned.
+ */
+int32 net_options(int handle, int32 options) {
+  netsocket *sp = &netsockets[handle];
+  int32 oldoptions = sp->options;
+  int on;
+
+  if (options == -1) return(oldoptions);
+  options &= NETOPT_NODELAY | NETOPT_CORK | NETOPT_UNBUFFERED;
+  sp->options = options;
+  if (sp->state != NETSTATE_CONNECTED) return(oldoptions);  /* Options are set once connected */
+  net_flush(handle);
+#ifdef TCP_NODELAY
+  on = (options & NETOPT_NODELAY) != 0;
+  setsockopt(sp->socket, IPPROTO_TCP, TCP_NODELAY, (char *)&on, sizeof(on));
+#endif
+#if defined(TCP_CORK)
+  on = (options & NETOPT_CORK) != 0;
+  setsockopt(sp->socket, IPPROTO_TCP, TCP_CORK, (char *)&on, sizeof(on));
+#elif defined(TCP_NOPUSH)
+  on = (options & NETOPT_CORK) != 0;
+  setsockopt(sp->socket, IPPROTO_TCP, TCP_NOPUSH, (char *)&on, sizeof(on));
+#endif
+  return(oldoptions);
+}
+
+#ifdef NET_PIPE
+/* This function waits until there is something to read on a socket, or it
+ * has been closed at the other end, or Escape is pressed.
+ */
+static void wait_readable(int mysocket) {
+  struct pollfd fds;
+
+  fds.fd = mysocket;
+  fds.events = POLLIN;
+  do {
+    fds.revents = 0;
+  } while (poll(&fds, 1, WAITSLICE * 10) <= 0 && !basicvars.escape);
+}
+#endif
 
 static int net_get_something(int handle) {
   int retval = 0;
+  netsocket *sp = &netsockets[handle];
 
   DEBUGFUNCMSGIN;
-  bufendptr[handle] = recv(netsockets[handle], netbuffer[handle], MAXNETRCVLEN, MSG_DONTWAIT);
-  if (bufendptr[handle] == 0) {
+  finish_connect(handle);
+  if (sp->state == NETSTATE_CONNECTING) {       /* Nothing to read yet */
+    DEBUGFUNCMSGOUT;
+    return(0);
+  }
+  if (sp->eof) {                                /* Connection failed */
+    DEBUGFUNCMSGOUT;
+    return(1);
+  }
+  if (sp->outlen > 0) net_flush(handle);      /* Send anything waiting before looking for a reply */
+  if (sp->buffer == NIL) {
+    sp->buffer = malloc(MAXNETRCVLEN);
+    if (sp->buffer == NIL) error(ERR_NOROOM);
+  }
+#ifdef NET_UDP
+  if (sp->datagram) {           /* Read the next datagram. An empty datagram is not end of file */
+    struct sockaddr_storage from;
+    socklen_t fromlen = sizeof(from);
+    sp->bufendptr = recvfrom(sp->socket, sp->buffer, MAXNETRCVLEN, MSG_DONTWAIT, (struct sockaddr *)&from, &fromlen);
+    if (sp->bufendptr >= 0) {
+      memcpy(&sp->peer, &from, fromlen);
+      sp->peerlen = fromlen;
+    }
+    if (sp->bufendptr == -1) sp->bufendptr = 0;
+    sp->bufptr = 0;
+    DEBUGFUNCMSGOUT;
+    return(0);
+  }
+#endif
+#ifdef NET_PIPE
+  if (sp->pid != 0) wait_readable(sp->socket);  /* Reads from a command wait for its output */
+#endif
+  sp->bufendptr = recv(sp->socket, sp->buffer, MAXNETRCVLEN, MSG_DONTWAIT);
+  if (sp->bufendptr == 0) {
     retval=1; /* EOF - connection closed */
-    neteof[handle] = 1;
+    sp->eof = 1;
   }
-  if (bufendptr[handle] == -1) bufendptr[handle] = 0;
-  bufptr[handle] = 0;
+  if (sp->bufendptr == -1) sp->bufendptr = 0;
+  sp->bufptr = 0;
   DEBUGFUNCMSGOUT;
   return(retval);
 }
@@ -381,47 +1198,200 @@ int32 net_bget(int handle) {
   int value;
 
   DEBUGFUNCMSGIN;
-  if (neteof[handle]) return(-2);
-  if (bufptr[handle] >= bufendptr[handle]) {
+  if (netsockets[handle].eof) return(-2);
+  if (netsockets[handle].bufptr >= netsockets[handle].bufendptr) {
     int retval=net_get_something(handle);
     if (retval) return(-2);                             /* EOF */
   }
-  if (bufptr[handle] >= bufendptr[handle]) return(-1);  /* No data available. EOF NOT set */
-  value=netbuffer[handle][(bufptr[handle])];
-  bufptr[handle]++;
+  if (netsockets[handle].bufptr >= netsockets[handle].bufendptr) return(-1);  /* No data available. EOF NOT set */
+  value=netsockets[handle].buffer[netsockets[handle].bufptr];
+  netsockets[handle].bufptr++;
   DEBUGFUNCMSGOUT;
   return(value & 0xFF);
 }
 
 boolean net_eof(int handle) {
   DEBUGFUNCMSGIN;
+  finish_connect(handle);
+#ifdef NET_PIPE
+/* Like a file, a "pipe:" handle is only at end of file when there is no more to read,
+ * so this waits for the command to send something or finish if nothing is buffered */
+  if (netsockets[handle].pid != 0 && netsockets[handle].bufptr >= netsockets[handle].bufendptr && !basicvars.escape) net_get_something(handle);
+#endif
   DEBUGFUNCMSGOUT;
-  return(neteof[handle]);
+  return(netsockets[handle].eof);
 }
 
-int net_bput(int handle, int32 value) {
-  char minibuf[2];
-  int retval;
+/* This function records the Basic file handle 'owner' that socket 'handle'
+ * belongs to. brandynet_wait() returns these rather than table indexes.
+ */
+void brandynet_setowner(int handle, int owner) {
+  netsockets[handle].owner = owner;
+}
+
+/* Add socket 'n' to the list of ready handles if it is not already on it
+ * and there is room, returning the new number of entries in the list.
+ */
+static int32 mark_ready(int n, int32 *ready, int32 maxready, int32 count) {
+  if (netsockets[n].ready || count >= maxready) return(count);
+  netsockets[n].ready = 1;
+  if (ready != NIL) ready[count] = netsockets[n].owner;
+  return(count+1);
+}
+
+/* This function asks the OS which sockets have data or connections waiting
+ * or have been closed, waiting for up to 'ms' milliseconds for one to
+ * become ready. The sockets found are added to 'ready'.
+ */
+static int32 wait_sockets(int32 *ready, int32 maxready, int32 count, int ms) {
+#if defined(USE_EPOLL)
+  struct epoll_event *events;
+  int n, found, wanted = maxready - count;
+
+  if (wanted > netcount) wanted = netcount;
+  if (wanted <= 0) return(count);       /* No room for any more ready sockets */
+  events = malloc(wanted * sizeof(struct epoll_event));
+  if (events == NIL) error(ERR_NOROOM);
+  found = epoll_wait(epollfd, events, wanted, ms);
+  for (n=0; n<found; n++) {
+    if (events[n].data.u32 != WAKEUP_EVENT) count = mark_ready(events[n].data.u32, ready, maxready, count);
+  }
+  free(events);
+#elif defined(USE_POLL)
+  struct pollfd *fds;
+  int n, found;
+
+  fds = malloc((netcount+1) * sizeof(struct pollfd));
+  if (fds == NIL) error(ERR_NOROOM);
+  for (n=0; n<netcount; n++) {
+    fds[n].fd = netsockets[n].socket ? netsockets[n].socket : -1;       /* Negative descriptors are ignored */
+    fds[n].events = POLLIN;
+    fds[n].revents = 0;
+  }
+  fds[netcount].fd = wakeup[0];         /* Wakes up poll() when a background connection finishes */
+  fds[netcount].events = POLLIN;
+  fds[netcount].revents = 0;
+  found = poll(fds, netcount+1, ms);
+  for (n=0; n<netcount && found>0; n++) {
+    if (fds[n].revents) count = mark_ready(n, ready, maxready, count);
+  }
+  free(fds);
+#else
+  fd_set fds;
+  struct timeval timeout;
+  int n, found, added = 0, maxfd = 0;
+
+  FD_ZERO(&fds);
+  for (n=0; n<netcount && added<FD_SETSIZE; n++) {
+    if (netsockets[n].socket <= 0) continue;
+    FD_SET(netsockets[n].socket, &fds);
+    if (netsockets[n].socket > maxfd) maxfd = netsockets[n].socket;
+    added++;
+  }
+  timeout.tv_sec = ms / 1000;
+  timeout.tv_usec = (ms % 1000) * 1000;
+  found = select(maxfd+1, &fds, NIL, NIL, &timeout);
+  for (n=0; n<netcount && found>0; n++) {
+    if (netsockets[n].socket > 0 && FD_ISSET(netsockets[n].socket, &fds)) count = mark_ready(n, ready, maxready, count);
+  }
+#endif
+  return(count);
+}
+
+/* This function adds sockets whose background connection has finished
+ * since they were last checked to 'ready'
+ */
+static int32 check_connections(int32 *ready, int32 maxready, int32 count) {
+  int n;
+#ifdef USE_WAKEUP
+  char discard[64];
+
+  while (read(wakeup[0], discard, sizeof(discard)) > 0);       /* Empty the wakeup pipe */
+#endif
+  for (n=0; n<netcount; n++) {
+    if (netsockets[n].state == NETSTATE_CONNECTING) {
+      finish_connect(n);
+      if (netsockets[n].state != NETSTATE_CONNECTING) count = mark_ready(n, ready, maxready, count);
+    }
+  }
+  return(count);
+}
+
+/* This function waits for up to 'timeout' centiseconds for any of the open
+ * sockets to have data or a connection waiting, or to be closed at the other
+ * end, or for a connection being made in the background to succeed or fail.
+ * A timeout of -1 waits until one does. The Basic handles of up to
+ * 'maxready' sockets that are ready are stored in 'ready' and the number
+ * found returned. If 'ready' is NIL, the sockets are just counted. The wait
+ * ends early if Escape is pressed.
+ */
+int32 brandynet_wait(int32 *ready, int32 maxready, int32 timeout) {
+  int n;
+  int32 count = 0;
 
   DEBUGFUNCMSGIN;
-  minibuf[0]=(value & 0xFFu);
-  minibuf[1]=0;
-  retval=send(netsockets[handle], (const char *)&minibuf, 1, 0);
-  if (retval == -1) {
-    DEBUGFUNCMSGOUT;
-    return(1);
+  if (matrixflags.networking == 0) error(ERR_NET_NOTSUPP);
+  if (ready == NIL) maxready = netcount;
+  if (maxready <= 0) return(0);
+  net_flushall();
+  for (n=0; n<netcount; n++) netsockets[n].ready = 0;
+/* Sockets with data already buffered or that are at end of file are ready now */
+  for (n=0; n<netcount; n++) {
+    if (netsockets[n].socket && (netsockets[n].eof || netsockets[n].bufptr < netsockets[n].bufendptr))
+      count = mark_ready(n, ready, maxready, count);
   }
+  if (count > 0) timeout = 0;
+  do {
+    int32 slice = (timeout < 0 || timeout > WAITSLICE) ? WAITSLICE : timeout;
+    count = check_connections(ready, maxready, count);
+    if (count > 0) slice = 0;
+    count = wait_sockets(ready, maxready, count, slice * 10);
+    if (timeout > 0) timeout -= slice;
+  } while (count == 0 && timeout != 0 && !basicvars.escape);
   DEBUGFUNCMSGOUT;
-  return(0);
+  return(count);
 }
 
+/* This function adds 'length' bytes to the send buffer of socket 'handle',
+ * sending the buffer whenever it fills up. The data is sent at once if the
+ * socket is unbuffered. It returns 1 if the data could not be sent.
+ */
 int net_bputstr(int handle, char *string, int32 length) {
-  int retval;
+  netsocket *sp = &netsockets[handle];
 
   DEBUGFUNCMSGIN;
+  if (sp->state < 0) {                  /* Connection could not be made */
+    DEBUGFUNCMSGOUT;
+    return(1);
+  }
   if (length == -1) length=strlen(string);
-  retval=send(netsockets[handle], string, length, 0);
-  if (retval == -1) {
+  if (sp->outbuf == NIL) {
+    sp->outbuf = malloc(sp->datagram ? MAXDGRAMLEN : MAXNETSNDLEN);
+    if (sp->outbuf == NIL) error(ERR_NOROOM);
+  }
+  if (sp->datagram) {           /* Everything up to the next flush is sent as one datagram */
+    if (sp->outlen + length > MAXDGRAMLEN) {
+      sp->outlen = 0;
+      DEBUGFUNCMSGOUT;
+      return(1);
+    }
+    memcpy(sp->outbuf + sp->outlen, string, length);
+    sp->outlen += length;
+    length = 0;
+  }
+  while (length > 0 && sp->outlen < MAXNETSNDLEN) {     /* Buffer stays full if Escape is pressed */
+    int count = MAXNETSNDLEN - sp->outlen;
+    if (count > length) count = length;
+    memcpy(sp->outbuf + sp->outlen, string, count);
+    sp->outlen += count;
+    string += count;
+    length -= count;
+    if (sp->outlen == MAXNETSNDLEN && net_flush(handle)) {
+      DEBUGFUNCMSGOUT;
+      return(1);
+    }
+  }
+  if ((sp->options & NETOPT_UNBUFFERED) && net_flush(handle)) {
     DEBUGFUNCMSGOUT;
     return(1);
   }
@@ -429,6 +1399,85 @@ int net_bputstr(int handle, char *string, int32 length) {
   return(0);
 }
 
+int net_bput(int handle, int32 value) {
+  netsocket *sp = &netsockets[handle];
+  char ch = value & 0xFFu;
+
+  if (sp->outbuf != NIL && sp->outlen < MAXNETSNDLEN - 1 && sp->state >= 0 && !(sp->options & NETOPT_UNBUFFERED)) {
+    sp->outbuf[sp->outlen++] = ch;       /* Fast path - just add the byte to the buffer */
+    return(0);
+  }
+  return(net_bputstr(handle, &ch, 1));
+}
+
+/* This function is called at the end of each BPUT# or PRINT# statement.
+ * On a UDP socket it sends everything written by the statement as one
+ * datagram. It returns 1 if this fails.
+ */
+int net_endwrite(int handle) {
+  if (netsockets[handle].datagram && netsockets[handle].outlen > 0) return(net_flush(handle));
+  return(0);
+}
+
+/* This function copies up to 'count' bytes of the data that has arrived on
+ * socket 'handle' into 'buffer' and returns the number copied. It does not
+ * wait for more data to arrive. On a UDP socket no more than the rest of
+ * the current datagram, or the next one, is copied.
+ */
+int32 net_read(int handle, char *buffer, int32 count) {
+  netsocket *sp = &netsockets[handle];
+  int32 length = 0;
+
+  DEBUGFUNCMSGIN;
+  while (length < count) {
+    int32 available = sp->bufendptr - sp->bufptr;
+    if (available <= 0) {
+      if (sp->eof || (sp->datagram && length > 0) || net_get_something(handle)) break;
+      available = sp->bufendptr - sp->bufptr;
+      if (available <= 0) break;        /* Nothing waiting */
+    }
+    if (available > count - length) available = count - length;
+    memcpy(buffer + length, sp->buffer + sp->bufptr, available);
+    sp->bufptr += available;
+    length += available;
+    if (sp->datagram) break;
+  }
+  DEBUGFUNCMSGOUT;
+  return(length);
+}
+
+/* This function copies the next line of text waiting on socket 'handle',
+ * up to and including the newline, into 'buffer', or on a UDP socket the
+ * rest of the current datagram or the next one to arrive. No more than
+ * 'maxlen' bytes are copied. It returns the number of bytes copied, which
+ * can be a partial line if no more data has arrived yet.
+ */
+int32 net_getline(int handle, char *buffer, int32 maxlen) {
+  netsocket *sp = &netsockets[handle];
+  int32 length = 0;
+
+  DEBUGFUNCMSGIN;
+  while (length < maxlen) {
+    int32 count = sp->bufendptr - sp->bufptr;
+    char *start, *lf;
+    if (count <= 0) {
+      if (sp->eof || (sp->datagram && length > 0) || net_get_something(handle)) break;
+      count = sp->bufendptr - sp->bufptr;
+      if (count <= 0) break;            /* Nothing waiting */
+    }
+    if (count > maxlen - length) count = maxlen - length;
+    start = sp->buffer + sp->bufptr;
+    lf = sp->datagram ? NIL : memchr(start, '\n', count);
+    if (lf != NIL) count = lf - start + 1;
+    memcpy(buffer + length, start, count);
+    sp->bufptr += count;
+    length += count;
+    if (lf != NIL || sp->datagram) break;
+  }
+  DEBUGFUNCMSGOUT;
+  return(length);
+}
+
 #ifndef BRANDY_NOVERCHECK
 /* This function queries the Matrix Brandy web server to check for a newer
  * version. This is a quick and dirty implementation talking raw HTML!
@@ -21,13 +21,34 @@
 #define BRANDY_NET_H
 #ifndef NONET
 #include "common.h"
+
+/* Options for net_options() */
+#define NETOPT_NODELAY    1     /* Disable Nagle's algorithm (TCP_NODELAY) */
+#define NETOPT_CORK       2     /* Only send full packets (TCP_CORK) */
+#define NETOPT_UNBUFFERED 4     /* Send data as soon as it is written */
+
 extern void brandynet_init();
 extern int brandynet_connect(char *dest, char type, int reporterrors);
+extern int brandynet_connect_async(char *dest, char type);
+extern int32 brandynet_status(int handle);
+extern int brandynet_listen(char *port, char type, int reporterrors);
+extern int brandynet_udp(char *dest, char type, int reporterrors);
+extern int brandynet_unix(char *path, int listening, int reporterrors);
+extern int brandynet_pipe(char *command, int reporterrors);
+extern int brandynet_shutdown(int handle);
+extern int brandynet_accept(int handle);
 extern int brandynet_close(int handle);
+extern void brandynet_setowner(int handle, int owner);
+extern int32 brandynet_wait(int32 *ready, int32 maxready, int32 timeout);
 extern int32 net_bget(int handle);
 extern boolean net_eof(int handle);
 extern int net_bput(int handle, int32 value);
 extern int net_bputstr(int handle, char *string, int32 length);
+extern int net_flush(int handle);
+extern int net_endwrite(int handle);
+extern int32 net_read(int handle, char *buffer, int32 count);
+extern int32 net_getline(int handle, char *buffer, int32 maxlen);
+extern int32 net_options(int handle, int32 options);
 #ifndef BRANDY_NOVERCHECK
 extern int checkfornewer(void);
 #endif
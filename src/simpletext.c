@@ -205,10 +205,25 @@ void emulate_vdu(int32 charvalue) {
 ** 'emulate_vdustr' is called to print a string via the 'VDU driver'
 */
 void emulate_vdustr(char string[], int32 length) {
-  int32 n;
+  int32 n, run;
   if (length==0) length = strlen(string);
   echo_off();
-  for (n=0; n<length; n++) emulate_vdu(string[n]);      /* Send the string to the VDU driver */
+  for (n=0; n<length; n++) {
+    if (vduneeded==0 && !vduflag(VDU_FLAG_DISABLE)) {   /* Write runs of printable characters in one go */
+      for (run=n; run<length && (string[run] & BYTEMASK)>=' ' && (string[run] & BYTEMASK)!=DEL; run++);
+      if (run>n) {
+        if (matrixflags.dospool) fwrite(string+n, 1, run-n, matrixflags.dospool);
+        if (matrixflags.printer) {
+          int32 p;
+          for (p=n; p<run; p++) printout_character(string[p] & BYTEMASK);
+        }
+        fwrite(string+n, 1, run-n, stdout);
+        n = run-1;
+        continue;
+      }
+    }
+    emulate_vdu(string[n]);      /* Send the string to the VDU driver */
+  }
   echo_on();
 }
 
@@ -222,13 +237,10 @@ void emulate_printf(char *format, ...) {
   int32 length;
   va_list parms;
   char text [MAXSTRING];
-  int n;
   va_start(parms, format);
   length = vsnprintf(text, MAXSTRING, format, parms);
   va_end(parms);
-  echo_off();
-  for (n = 0; n < length; n++) emulate_vdu(text[n]);
-  echo_on();
+  if (length > 0) emulate_vdustr(text, length);
 }
 
 /*
@@ -379,8 +379,8 @@ static void (*statements[256])(void) = {
   exec_assignment, exec_assignment, exec_assignment,  exec_xproc,       /* 0C..0F */
   exec_proc,       bad_syntax,      bad_syntax,       bad_syntax,       /* 10..13 */
   bad_syntax,      bad_syntax,      bad_syntax,       bad_syntax,       /* 14..17 */
-  bad_syntax,      bad_syntax,      bad_token,        bad_token,        /* 18..1B */
-  bad_token,       bad_token,       bad_token,        bad_token,        /* 1C..1F */
+  bad_syntax,      bad_syntax,      bad_token,        exec_assignment,  /* 18..1B */
+  exec_assignment, bad_token,       bad_token,        bad_token,        /* 1C..1F */
   skip_colon,      exec_assignment, bad_syntax,       bad_syntax,       /* 20..23 */
   exec_assignment, bad_syntax,      bad_syntax,       bad_syntax,       /* 24..27 */
   bad_syntax,      bad_syntax,      bad_syntax,       bad_syntax,       /* 28..2B */
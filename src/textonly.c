@@ -1151,6 +1151,34 @@ static void print_char(int32 charvalue) {
   }
 }
 
+/*
+** 'print_run' displays the 'count' printable characters at 'text'. The
+** characters up to the edge of the text window are written in one go
+** -- ANSI --
+*/
+static void print_run(char *text, int32 count) {
+  int32 fit;
+  if (basicvars.runflags.outredir) {    /* Output is going elsewhere, probably a file */
+    fwrite(text, 1, count, stdout);
+    return;
+  }
+  while (count > 0) {
+    fit = twinright-xtext+1;
+    if (fit < 1) fit = 1;
+    if (fit > count) fit = count;
+    fwrite(text, 1, fit, stdout);
+    xtext += fit;
+    text += fit;
+    count -= fit;
+    if (xtext>twinright) {              /* Have reached edge of text window. Skip to next line  */
+      xtext = twinleft;
+      ytext++;
+      printf("\n\033[%dG", xtext+1);
+    }
+  }
+  if (vduflag(VDU_FLAG_ECHO)) fflush(stdout);
+}
+
 #else
 
 /*
@@ -1181,6 +1209,13 @@ static void print_char(int32 charvalue) {
   }
 }
 
+/*
+** 'print_run' displays the 'count' printable characters at 'text'
+*/
+static void print_run(char *text, int32 count) {
+  while (count-- > 0) print_char(*text++ & BYTEMASK);
+}
+
 #endif
 
 static void vdu_plot(void) {
@@ -1341,13 +1376,27 @@ void emulate_vdu(int32 charvalue) {
 }
 
 /*
-** 'emulate_vdustr' is called to print a string via the 'VDU driver'
+** 'emulate_vdustr' is called to print a string via the 'VDU driver'.
+** Runs of printable characters are displayed in one go
 */
 void emulate_vdustr(char string[], int32 length) {
-  int32 n;
+  int32 n, run;
   if (length==0) length = strlen(string);
   echo_off();
   for (n=0; n<length; n++) {
+    if (vduneeded==0 && basicvars.printwidth==0 && !vduflag(VDU_FLAG_DISABLE)) {
+      for (run=n; run<length && (string[run] & BYTEMASK)>=' ' && (string[run] & BYTEMASK)!=DEL; run++);
+      if (run>n) {
+        if (matrixflags.dospool) fwrite(string+n, 1, run-n, matrixflags.dospool);
+        if (matrixflags.printer) {
+          int32 p;
+          for (p=n; p<run; p++) printout_character(string[p] & BYTEMASK);
+        }
+        print_run(string+n, run-n);
+        n = run-1;
+        continue;
+      }
+    }
     emulate_vdu(string[n]);      /* Send the string to the VDU driver */
     if (basicvars.printwidth > 0) {
       if (emulate_pos() == basicvars.printwidth) {
@@ -1367,15 +1416,13 @@ void emulate_vdustr(char string[], int32 length) {
 ** to the screen
 */
 void emulate_printf(char *format, ...) {
-  int32 n, length;
+  int32 length;
   va_list parms;
   char text [MAXSTRING];
   va_start(parms, format);
   length = vsnprintf(text, MAXSTRING, format, parms);
   va_end(parms);
-  echo_off();
-  for (n = 0; n < length; n++) emulate_vdu(text[n]);
-  echo_on();
+  if (length > 0) emulate_vdustr(text, length);
 }
 
 /*
@@ -1501,8 +1501,8 @@ static int skiptable [] = {
   LOFFSIZE,         LOFFSIZE,         1,         LOFFSIZE,  /* 0C..0F */
   LOFFSIZE,         0,                0,         SMALLSIZE, /* 10..13 */
   INTSIZE,          0,                0,         FLOATSIZE, /* 14..17 */
-  OFFSIZE+SIZESIZE, OFFSIZE+SIZESIZE, INT64SIZE, -1,        /* 18..1B */
-  -1,               -1,               LOFFSIZE,  LOFFSIZE,  /* 1C..1F */
+  OFFSIZE+SIZESIZE, OFFSIZE+SIZESIZE, INT64SIZE, LOFFSIZE,  /* 18..1B */
+  LOFFSIZE,         -1,               LOFFSIZE,  LOFFSIZE,  /* 1C..1F */
    0,  0, -1,  0,  0,  0,  0,  0,                           /* 20..27 */
    0,  0,  0,  0,  0,  0,  0,  0,                           /* 28..2F */
   -1, -1, -1, -1, -1, -1, -1, -1,                           /* 30..37 */
@@ -1965,7 +1965,8 @@ static void clear_varaddrs(byte *bp) {
       DEBUGFUNCMSGOUT;
       return;
     }
-    if (*tp == BASTOKEN_XVAR || (*tp >= BASTOKEN_UINT8VAR && *tp <= BASTOKEN_FLOATINDVAR)) {
+    if (*tp == BASTOKEN_XVAR || (*tp >= BASTOKEN_UINT8VAR && *tp <= BASTOKEN_FLOATINDVAR)
+     || *tp == BASTOKEN_ARRAYREF2 || *tp == BASTOKEN_ARRAYREF3) {
       while (*sp != BASTOKEN_XVAR && *sp != asc_NUL) sp = skip_source(sp);     /* Locate variable in source part of line */
       if (*sp == asc_NUL) {
         error(ERR_BROKEN, __LINE__, "tokens");            /* Cannot find variable - Logic error */
@@ -93,14 +93,14 @@
 #define BASTOKEN_STRINGCON   0x18u           /* Ordinary string constant */
 #define BASTOKEN_QSTRINGCON  0x19u           /* String constant with a '"' in it */
 #define BASTOKEN_INT64CON    0x1Au           /* 64-bit integer constant */
+#define BASTOKEN_ARRAYREF2   0x1Bu           /* Two-dimensional array element with integer variable indexes */
+#define BASTOKEN_ARRAYREF3   0x1Cu           /* Three-dimensional array element with integer variable indexes */
 
 #define BASTOKEN_XLINENUM    0x1Eu           /* Unresolved line number reference */
 #define BASTOKEN_LINENUM     0x1Fu           /* Resolved line number reference */
 
 /* Unused tokens */
 
-#define UNUSED_1B       0x1Bu
-#define UNUSED_1C       0x1Cu
 #define UNUSED_1D       0x1Du
 
 /* Operators */
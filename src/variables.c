@@ -549,7 +549,7 @@ void define_array(variable *vp, boolean islocal, boolean offheap) {
       return;
     }
     highindex++;        /* Add 1 to get size of dimension */
-    if (dimcount>MAXDIMS) {
+    if (dimcount>=MAXDIMS) {
       error(ERR_DIMCOUNT, vp->varname);     /* Array has too many dimemsions */
       return;
     }
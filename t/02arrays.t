@@ -0,0 +1,49 @@
+#!sbrandy
+REM https://testanything.org/
+PRINT "1..10"
+
+DIM A(3), B(3), C(3), I%(3)
+B() = 1, 2, 3, 4
+C() = 10, 20, 30, 40
+
+A() = B()*2 + C()
+IF A(0) = 12 AND A(3) = 48 THEN PRINT "ok 1" ELSE PRINT "not ok 1"
+A() = B() + C()*2
+IF A(0) = 21 AND A(3) = 84 THEN PRINT "ok 2" ELSE PRINT "not ok 2"
+A() = A()/2 - B()
+IF A(0) = 9.5 AND A(3) = 38 THEN PRINT "ok 3" ELSE PRINT "not ok 3"
+X = 3
+A() = X - B()*C()/10
+IF A(0) = 2 AND A(3) = -13 THEN PRINT "ok 4" ELSE PRINT "not ok 4"
+I%() = B()*2 + C()
+IF I%(1) = 24 THEN PRINT "ok 5" ELSE PRINT "not ok 5"
+
+DIM G%(3,4), H(2,3,4)
+FOR I% = 0 TO 3 : FOR J% = 0 TO 4 : G%(I%,J%) = I%*10+J% : NEXT : NEXT
+S% = 0
+FOR I% = 0 TO 3 : FOR J% = 0 TO 4 : S% += G%(I%,J%) : NEXT : NEXT
+IF S% = 340 AND G%(2,3) = 23 THEN PRINT "ok 6" ELSE PRINT "not ok 6"
+FOR x% = 0 TO 2 : FOR y% = 0 TO 3 : FOR z% = 0 TO 4 : H(x%,y%,z%) = x%*100+y%*10+z% : NEXT : NEXT : NEXT
+x% = 1 : y% = 2 : z% = 3
+IF H(x%,y%,z%) = 123 AND H(2,3,4) = 234 THEN PRINT "ok 7" ELSE PRINT "not ok 7"
+DIM M(1,1), P(1,2), Q(2,1)
+P() = 1 : Q() = 2
+M() = P().Q()
+IF M(0,0) = 6 AND M(1,1) = 6 THEN PRINT "ok 8" ELSE PRINT "not ok 8"
+DIM D%% 71
+P%% = PTR(G%())
+FOR K% = 0 TO 71 : D%%?K% = P%%?K% : NEXT
+DIM N%(3,4)
+PTR(N%()) = D%%
+I% = 2 : J% = 3
+IF N%(2,3) = 23 AND N%(I%,J%) = 23 AND N%(3,4) = 34 THEN PRINT "ok 9" ELSE PRINT "not ok 9"
+DIM Y(3), W(3)
+Y() = 5 : W() = 2, 2, 0, 2
+PROCdivide
+IF Y(0) = 5 AND Y(1) = 5 AND Y(3) = 5 THEN PRINT "ok 10" ELSE PRINT "not ok 10"
+END
+
+DEF PROCdivide
+ON ERROR LOCAL ENDPROC
+Y() = Y()/W()
+ENDPROC
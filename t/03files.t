@@ -0,0 +1,40 @@
+#!sbrandy
+REM https://testanything.org/
+PRINT "1..8"
+
+N$ = "03files.tmp"
+F% = OPENOUT(N$)
+PRINT#F%, 42, -7, 3.25, "hello", STRING$(300, "x")
+FOR I% = 0 TO 99999 : BPUT#F%, I% AND 255 : NEXT
+BPUT#F%, "line1"
+IF EXT#F% = 100337 AND PTR#F% = 100337 THEN PRINT "ok 1" ELSE PRINT "not ok 1"
+CLOSE#F%
+
+F% = OPENIN(N$)
+INPUT#F%, A%, B%, C, S$, L$
+IF A% = 42 AND B% = -7 AND C = 3.25 AND S$ = "hello" AND LEN(L$) = 300 THEN PRINT "ok 2" ELSE PRINT "not ok 2"
+S% = 0
+FOR I% = 0 TO 99999 : S% += BGET#F% : NEXT
+IF S% = 12742320 THEN PRINT "ok 3" ELSE PRINT "not ok 3"
+IF GET$#F% = "line1" AND EOF#F% THEN PRINT "ok 4" ELSE PRINT "not ok 4"
+CLOSE#F%
+
+F% = OPENUP(N$)
+PTR#F% = 60000 : BPUT#F%, 1 : PTR#F% = 5 : BPUT#F%, 2
+PTR#F% = 60000 : A% = BGET#F% : PTR#F% = 5
+IF A% = 1 AND BGET#F% = 2 AND PTR#F% = 6 THEN PRINT "ok 5" ELSE PRINT "not ok 5"
+EXT#F% = 10
+IF EXT#F% = 10 THEN PRINT "ok 6" ELSE PRINT "not ok 6"
+CLOSE#F%
+
+DIM A%(99), B%(199)
+FOR I% = 0 TO 99 : A%(I%) = I%*1000 : NEXT
+F% = OPENOUT(N$)
+SYS "OS_GBPB", 2, F%, ](PTR(A%())+8), 400
+SYS "OS_GBPB", 3, F%, ](PTR(B%())+8), 800, 0 TO ,,,R3%,R4% ; FL%
+IF B%(99) = 99000 AND R3% = 400 AND R4% = 400 AND (FL% AND 2) <> 0 THEN PRINT "ok 7" ELSE PRINT "not ok 7"
+CLOSE#F%
+DIM R$(10)
+OSCLI "printf 'x\n'; ls " + N$ + "; printf 'a \n\nb'" TO R$(), L%
+IF L% = 5 AND R$(2) = N$ AND R$(3) = "a" AND R$(4) = "" AND R$(5) = "b" THEN PRINT "ok 8" ELSE PRINT "not ok 8"
+OSCLI "rm -f " + N$
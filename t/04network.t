@@ -0,0 +1,86 @@
+#!sbrandy
+REM https://testanything.org/
+PRINT "1..11"
+
+REM Ports and the socket file are chosen from the process ID so that
+REM several copies of the tests can run at once
+DIM R$(1)
+OSCLI "echo $PPID" TO R$()
+PID% = VAL R$(1)
+PORT% = 20000 + PID% MOD 20000
+L% = FNlisten
+SYS "Brandy_NetAccept", L% TO A%
+IF L% <> 0 AND A% = 0 THEN PRINT "ok 1" ELSE PRINT "not ok 1"
+C% = OPENUP("ip4:127.0.0.1:" + STR$PORT%)
+DIM R% 63
+SYS "Brandy_NetWait", 500, R%, 16 TO N%
+IF N% = 1 AND R%!0 = L% THEN PRINT "ok 2" ELSE PRINT "not ok 2"
+SYS "Brandy_NetAccept", L% TO A%
+IF A% <> 0 THEN PRINT "ok 3" ELSE PRINT "not ok 3"
+BPUT#C%, "hello"
+SYS "Brandy_NetWait", 500, R%, 16 TO N%
+IF N% = 1 AND R%!0 = A% THEN PRINT "ok 4" ELSE PRINT "not ok 4"
+T% = TIME
+S$ = ""
+REPEAT B% = BGET#A% : IF B% > 0 S$ += CHR$B%
+UNTIL B% = 10 OR TIME > T% + 500
+IF S$ = "hello" + CHR$10 THEN PRINT "ok 5" ELSE PRINT "not ok 5"
+PRINT#C%, "abc"
+SYS "Brandy_NetFlush", C%
+SYS "Brandy_NetWait", 500, R%, 16 TO N%
+S$ = ""
+FOR I% = 1 TO 5 : S$ += STR$BGET#A% + " " : NEXT
+IF S$ = "0 3 99 98 97 " THEN PRINT "ok 6" ELSE PRINT "not ok 6"
+SYS "Brandy_NetConnect", "ip4:127.0.0.1:" + STR$PORT% TO D%
+T% = TIME
+REPEAT SYS "Brandy_NetStatus", D% TO S% : UNTIL S% <> 1 OR TIME > T% + 500
+IF S% = 0 THEN PRINT "ok 7" ELSE PRINT "not ok 7"
+CLOSE#D% : CLOSE#C% : CLOSE#A% : CLOSE#L%
+
+U% = OPENUP("udp4::" + STR$PORT%)
+V% = OPENUP("udp4:127.0.0.1:" + STR$PORT%)
+BPUT#V%, "one"
+BPUT#V%, "tw";"o";
+SYS "Brandy_NetWait", 500, R%, 16 TO N%
+A$ = GET$#U% : B$ = GET$#U%
+IF A$ = "one" AND B$ = "two" THEN PRINT "ok 8" ELSE PRINT "not ok 8"
+BPUT#V%, STRING$(300, "x") + "yz";
+SYS "Brandy_NetWait", 500, R%, 16 TO N%
+A$ = GET$#U% BY 256 : B$ = GET$#U% BY 256
+IF LEN A$ = 256 AND B$ = STRING$(44, "x") + "yz" THEN PRINT "ok 9" ELSE PRINT "not ok 9"
+CLOSE#V% : CLOSE#U%
+
+SOCK$ = "/tmp/brandy-04network-" + STR$PID% + ".sock"
+OSCLI "rm -f " + SOCK$
+L% = OPENUP("unix::" + SOCK$)
+C% = OPENUP("unix:" + SOCK$)
+SYS "Brandy_NetWait", 500, R%, 16 TO N%
+SYS "Brandy_NetAccept", L% TO A%
+BPUT#C%, "local"
+SYS "Brandy_NetWait", 500, R%, 16 TO N%
+IF A% <> 0 AND GET$#A% = "local" THEN PRINT "ok 10" ELSE PRINT "not ok 10"
+CLOSE#C% : CLOSE#A% : CLOSE#L%
+OSCLI "rm -f " + SOCK$
+
+P% = OPENUP("pipe:sort")
+BPUT#P%, "pear" : BPUT#P%, "apple"
+SYS "Brandy_NetShutdown", P%
+A$ = GET$#P% : B$ = GET$#P%
+IF A$ = "apple" AND B$ = "pear" AND EOF#P% THEN PRINT "ok 11" ELSE PRINT "not ok 11"
+CLOSE#P%
+END
+
+REM Listen on PORT%, moving on to the next port if it is in use
+DEF FNlisten
+LOCAL H%, N%
+H% = 0
+FOR N% = 1 TO 10
+  H% = FNtrylisten
+  IF H% = 0 THEN PORT% += 1
+  IF H% <> 0 THEN N% = 10
+NEXT
+= H%
+
+DEF FNtrylisten
+ON ERROR LOCAL = 0
+= OPENUP("ip4::" + STR$PORT%)
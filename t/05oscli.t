@@ -0,0 +1,23 @@
+#!sbrandy
+REM https://testanything.org/
+PRINT "1..5"
+
+DIM R$(10)
+OSCLI "echo plain  words" TO R$(), L%
+IF L% = 1 AND R$(1) = "plain words" THEN PRINT "ok 1" ELSE PRINT "not ok 1"
+OSCLI "type echo" TO R$(), L%
+IF L% = 1 AND INSTR(R$(1), "builtin") > 0 THEN PRINT "ok 2" ELSE PRINT "not ok 2"
+OSCLI "export BRANDYTEST=1" TO R$(), L%
+IF L% = 0 THEN PRINT "ok 3" ELSE PRINT "not ok 3"
+OSCLI "echo one; echo two | tr o 0" TO R$(), L%
+IF L% = 2 AND R$(1) = "one" AND R$(2) = "tw0" THEN PRINT "ok 4" ELSE PRINT "not ok 4"
+DIM S$(3)
+OSCLI "mktemp" TO R$(), L%
+F$ = R$(1)
+OSCLI "seq 1 200000 && echo done >"+F$ TO S$(), L%
+D$ = ""
+F% = OPENIN(F$)
+IF F% THEN IF EXT#F% THEN D$ = GET$#F%
+IF F% THEN CLOSE#F%
+OSCLI "rm -f "+F$
+IF L% = 3 AND S$(3) = "3" AND D$ = "done" THEN PRINT "ok 5" ELSE PRINT "not ok 5"